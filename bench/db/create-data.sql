@@ -0,0 +1,63 @@
+--
+--  Synthetic base data for the benchmarks. Needs the psql variables users,
+--  changesets, nodes, ways, way_nodes, relations, and relation_members.
+--  All objects get version 1.
+--
+
+BEGIN;
+
+INSERT INTO users (id, email, pass_crypt, creation_time, display_name, data_public)
+    SELECT g, 'user' || g || '@example.com', 'xxx', '2020-01-01T00:00:00Z', 'user ' || g, true
+        FROM generate_series(1, :users) AS g;
+
+INSERT INTO changesets (id, user_id, created_at, closed_at)
+    SELECT g, 1 + g % :users, '2020-01-01T00:00:00Z', '2020-01-01T01:00:00Z'
+        FROM generate_series(1, :changesets) AS g;
+
+INSERT INTO nodes (node_id, latitude, longitude, changeset_id, visible, "timestamp", tile, version)
+    SELECT g, (random() * 1700000000 - 850000000)::integer,
+              (random() * 3600000000 - 1800000000)::integer,
+              1 + g % :changesets, true, '2020-01-01T00:00:00Z', 0, 1
+        FROM generate_series(1, :nodes) AS g;
+
+INSERT INTO node_tags (node_id, version, k, v)
+    SELECT g, 1, 'amenity', 'bench'
+        FROM generate_series(1, :nodes, 10) AS g;
+
+INSERT INTO ways (way_id, changeset_id, "timestamp", version, visible)
+    SELECT g, 1 + g % :changesets, '2020-01-01T00:00:00Z', 1, true
+        FROM generate_series(1, :ways) AS g;
+
+INSERT INTO way_nodes (way_id, node_id, version, sequence_id)
+    SELECT w, 1 + (w * :way_nodes + s) % :nodes, 1, s
+        FROM generate_series(1, :ways) AS w, generate_series(1, :way_nodes) AS s;
+
+INSERT INTO way_tags (way_id, k, v, version)
+    SELECT g, 'highway', 'residential', 1
+        FROM generate_series(1, :ways) AS g;
+
+INSERT INTO way_tags (way_id, k, v, version)
+    SELECT g, 'name', 'Street ' || g, 1
+        FROM generate_series(1, :ways) AS g;
+
+INSERT INTO relations (relation_id, changeset_id, "timestamp", version, visible)
+    SELECT g, 1 + g % :changesets, '2020-01-01T00:00:00Z', 1, true
+        FROM generate_series(1, :relations) AS g;
+
+INSERT INTO relation_members (relation_id, member_type, member_id, member_role, version, sequence_id)
+    SELECT r,
+           CASE WHEN s % 10 = 0 THEN 'Node' ELSE 'Way' END::nwr_enum,
+           CASE WHEN s % 10 = 0 THEN 1 + (r * :relation_members + s) % :nodes
+                                ELSE 1 + (r * :relation_members + s) % :ways END,
+           CASE WHEN s % 10 = 0 THEN 'label' ELSE 'outer' END,
+           1, s
+        FROM generate_series(1, :relations) AS r, generate_series(1, :relation_members) AS s;
+
+INSERT INTO relation_tags (relation_id, k, v, version)
+    SELECT g, 'type', 'multipolygon', 1
+        FROM generate_series(1, :relations) AS g;
+
+COMMIT;
+
+ANALYZE;
+
@@ -0,0 +1,57 @@
+--
+--  Create a new version of the first round_nodes nodes, round_ways ways,
+--  and round_relations relations in a single transaction, all in the new
+--  changeset with the id changeset at timestamp ts.
+--
+
+BEGIN;
+
+INSERT INTO changesets (id, user_id, created_at, closed_at)
+    VALUES (:changeset, 1, :'ts', :'ts');
+
+CREATE TEMP TABLE bench_nodes ON COMMIT DROP AS
+    SELECT DISTINCT ON (node_id) node_id, version FROM nodes
+        WHERE node_id <= :round_nodes ORDER BY node_id, version DESC;
+
+INSERT INTO nodes (node_id, latitude, longitude, changeset_id, visible, "timestamp", tile, version)
+    SELECT n.node_id, n.latitude + 1, n.longitude + 1, :changeset, true, :'ts', n.tile, n.version + 1
+        FROM nodes n JOIN bench_nodes b USING (node_id, version);
+
+INSERT INTO node_tags (node_id, version, k, v)
+    SELECT t.node_id, t.version + 1, t.k, t.v
+        FROM node_tags t JOIN bench_nodes b USING (node_id, version);
+
+CREATE TEMP TABLE bench_ways ON COMMIT DROP AS
+    SELECT DISTINCT ON (way_id) way_id, version FROM ways
+        WHERE way_id <= :round_ways ORDER BY way_id, version DESC;
+
+INSERT INTO ways (way_id, changeset_id, "timestamp", version, visible)
+    SELECT w.way_id, :changeset, :'ts', w.version + 1, true
+        FROM ways w JOIN bench_ways b USING (way_id, version);
+
+INSERT INTO way_nodes (way_id, node_id, version, sequence_id)
+    SELECT n.way_id, n.node_id, n.version + 1, n.sequence_id
+        FROM way_nodes n JOIN bench_ways b USING (way_id, version);
+
+INSERT INTO way_tags (way_id, k, v, version)
+    SELECT t.way_id, t.k, t.v, t.version + 1
+        FROM way_tags t JOIN bench_ways b USING (way_id, version);
+
+CREATE TEMP TABLE bench_relations ON COMMIT DROP AS
+    SELECT DISTINCT ON (relation_id) relation_id, version FROM relations
+        WHERE relation_id <= :round_relations ORDER BY relation_id, version DESC;
+
+INSERT INTO relations (relation_id, changeset_id, "timestamp", version, visible)
+    SELECT r.relation_id, :changeset, :'ts', r.version + 1, true
+        FROM relations r JOIN bench_relations b USING (relation_id, version);
+
+INSERT INTO relation_members (relation_id, member_type, member_id, member_role, version, sequence_id)
+    SELECT m.relation_id, m.member_type, m.member_id, m.member_role, m.version + 1, m.sequence_id
+        FROM relation_members m JOIN bench_relations b USING (relation_id, version);
+
+INSERT INTO relation_tags (relation_id, k, v, version)
+    SELECT t.relation_id, t.k, t.v, t.version + 1
+        FROM relation_tags t JOIN bench_relations b USING (relation_id, version);
+
+COMMIT;
+
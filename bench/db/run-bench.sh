@@ -0,0 +1,136 @@
+#!/bin/sh
+#
+#  Benchmark osmdbt-get-log, osmdbt-fake-log, and osmdbt-create-diff end to
+#  end on a synthetic database. Must be run under pg_virtualenv (see
+#  README.md), usually through "make bench".
+#
+#  Usage: run-bench.sh SRCDIR BINDIR
+#
+#  The size of the dataset and the size of the logs can be set through
+#  these environment variables (defaults in parentheses):
+#
+#  BENCH_USERS (1000), BENCH_CHANGESETS (10000), BENCH_NODES (1000000),
+#  BENCH_WAYS (100000), BENCH_WAY_NODES (50, nodes per way),
+#  BENCH_RELATIONS (10000), BENCH_RELATION_MEMBERS (100, members per
+#  relation), BENCH_LOG_SIZES ("1000 10000 100000", number of changed
+#  objects in each log, 60% nodes, 30% ways, 10% relations),
+#  BENCH_CREATE_DIFF_OPTIONS (none, additional options for create-diff)
+#
+
+set -e
+
+if [ "x$PG_CLUSTER_CONF_ROOT" = "x" ]; then
+    echo
+    echo "X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X"
+    echo
+    echo "Not running under pg_virtualenv. See README.md"
+    echo
+    echo "X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X-X"
+    echo
+    exit 1
+fi
+
+SRCDIR=$1
+BINDIR=$2
+BENCHDIR=`pwd`
+
+: ${BENCH_USERS:=1000}
+: ${BENCH_CHANGESETS:=10000}
+: ${BENCH_NODES:=1000000}
+: ${BENCH_WAYS:=100000}
+: ${BENCH_WAY_NODES:=50}
+: ${BENCH_RELATIONS:=10000}
+: ${BENCH_RELATION_MEMBERS:=100}
+: ${BENCH_LOG_SIZES:="1000 10000 100000"}
+
+RESULTS=$BENCHDIR/bench-results.txt
+CONFIG=$BENCHDIR/bench-config.yaml
+
+# Remove files left over from previous runs
+rm -f osm-repl-*.log osm-repl-*.osc.gz osm-repl-*.osc.gz.new $RESULTS
+
+cat >$CONFIG <<EOC
+---
+database:
+    host: $PGHOST
+    port: $PGPORT
+    dbname: $PGDATABASE
+    user: $PGUSER
+    password: $PGPASSWORD
+    replication_slot: bench
+log_dir: $BENCHDIR
+changes_dir: $BENCHDIR
+run_dir: $BENCHDIR
+EOC
+
+now() {
+    date +%s.%N
+}
+
+# Run command, append "SIZE STEP SECONDS MAX_RSS_KB" to the results. The
+# maximum resident set size is only available if GNU time is installed.
+run_timed() {
+    size=$1
+    step=$2
+    shift 2
+    rss=-
+    start=`now`
+    if [ -x /usr/bin/time ]; then
+        /usr/bin/time -o $BENCHDIR/bench-rss -f %M "$@" -q -c $CONFIG
+        rss=`cat $BENCHDIR/bench-rss`
+    else
+        "$@" -q -c $CONFIG
+    fi
+    end=`now`
+    awk "BEGIN { printf \"%8d  %-12s %10.3f %12s\n\", $size, \"$step\", $end - $start, \"$rss\" }" | tee -a $RESULTS
+}
+
+echo "Creating database schema..."
+psql -q <$SRCDIR/structure.sql
+
+echo "Creating synthetic data..."
+start=`now`
+psql -q -v ON_ERROR_STOP=1 \
+    -v users=$BENCH_USERS \
+    -v changesets=$BENCH_CHANGESETS \
+    -v nodes=$BENCH_NODES \
+    -v ways=$BENCH_WAYS \
+    -v way_nodes=$BENCH_WAY_NODES \
+    -v relations=$BENCH_RELATIONS \
+    -v relation_members=$BENCH_RELATION_MEMBERS \
+    -f $SRCDIR/bench/db/create-data.sql
+end=`now`
+awk "BEGIN { printf \"Created data in %.1f seconds\n\", $end - $start }"
+
+$BINDIR/osmdbt-enable-replication -q -c $CONFIG
+
+echo "    size  step            seconds   max_rss_kb" | tee $RESULTS
+
+round=0
+for size in $BENCH_LOG_SIZES; do
+    round=`expr $round + 1`
+    ts=`date -u +%Y-%m-%dT%H:%M:%SZ`
+
+    psql -q -v ON_ERROR_STOP=1 \
+        -v changeset=`expr $BENCH_CHANGESETS + $round` \
+        -v ts=$ts \
+        -v round_nodes=`expr $size \* 6 / 10` \
+        -v round_ways=`expr $size \* 3 / 10` \
+        -v round_relations=`expr $size / 10` \
+        -f $SRCDIR/bench/db/edit-data.sql
+
+    run_timed $size get-log $BINDIR/osmdbt-get-log --catchup
+    log=`ls -t osm-repl-*-lsn-*.log | head -n 1`
+
+    run_timed $size fake-log $BINDIR/osmdbt-fake-log -t $ts
+
+    run_timed $size create-diff $BINDIR/osmdbt-create-diff -f $log $BENCH_CREATE_DIFF_OPTIONS
+
+    # Make sure the next round has a different timestamp
+    sleep 1
+done
+
+$BINDIR/osmdbt-disable-replication -q -c $CONFIG
+
+echo "Results are in $RESULTS"
+
@@ -0,0 +1,442 @@
+/*
+ * Micro-benchmarks for the CPU-bound parts of create-diff: log parsing,
+ * sorting, and building the osmium buffer from query results, and of the
+ * filtering of already logged objects in fake-log. Instead of
+ * database results they use generated in-memory rows, so no database is
+ * needed. The "allocs" counter shows the number of heap allocations per
+ * iteration.
+ */
+
+#include "filter.hpp"
+#include "osmobj.hpp"
+
+#include <osmium/memory/buffer.hpp>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+static std::atomic<std::size_t> allocations{0};
+
+void *operator new(std::size_t size)
+{
+    ++allocations;
+    if (void *ptr = std::malloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+
+void operator delete(void *ptr, std::size_t /*size*/) noexcept
+{
+    std::free(ptr);
+}
+
+class AllocationCounter
+{
+public:
+    explicit AllocationCounter(benchmark::State &state)
+    : m_state(state), m_start(allocations.load())
+    {}
+
+    ~AllocationCounter()
+    {
+        m_state.counters["allocs"] = benchmark::Counter(
+            static_cast<double>(allocations.load() - m_start),
+            benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State &m_state;
+    std::size_t m_start;
+}; // class AllocationCounter
+
+/// Stands in for pqxx::field.
+class FakeField
+{
+public:
+    explicit FakeField(std::string value) : m_value(std::move(value)) {}
+
+    char const *c_str() const noexcept { return m_value.c_str(); }
+
+    template <typename T>
+    T as() const noexcept
+    {
+        return static_cast<T>(std::strtoll(m_value.c_str(), nullptr, 10));
+    }
+
+private:
+    std::string m_value;
+}; // class FakeField
+
+/// Stands in for pqxx::row.
+using FakeRow = std::vector<FakeField>;
+
+/// Stands in for pqxx::result.
+using FakeResult = std::vector<FakeRow>;
+
+static std::string create_log(std::size_t num_objects)
+{
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<long> id_dist{1, 8000000000};
+    std::uniform_int_distribution<int> type_dist{0, 9};
+    std::uniform_int_distribution<int> version_dist{1, 20};
+
+    std::string data;
+    data.reserve(num_objects * 50);
+    for (std::size_t i = 0; i < num_objects; ++i) {
+        int const t = type_dist(gen);
+        char const type = t < 6 ? 'n' : (t < 9 ? 'w' : 'r');
+        data += "C/AAA1A108 59940 N ";
+        data += type;
+        data += std::to_string(id_dist(gen));
+        data += " v";
+        data += std::to_string(version_dist(gen));
+        data += " c";
+        data += std::to_string(80864722 + i / 1000);
+        data += '\n';
+    }
+    return data;
+}
+
+static std::string write_log(std::size_t num_objects)
+{
+    std::string const file_name{"osmdbt-micro-bench-" +
+                                std::to_string(num_objects) + ".log"};
+    std::ofstream file{file_name};
+    file << create_log(num_objects);
+    return file_name;
+}
+
+static void BM_read_log(benchmark::State &state)
+{
+    auto const file_name = write_log(static_cast<std::size_t>(state.range(0)));
+
+    {
+        AllocationCounter counter{state};
+        for (auto _ : state) {
+            changeset_user_lookup cucache;
+            auto objects = read_log(".", file_name, &cucache);
+            benchmark::DoNotOptimize(objects.data());
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    std::remove(file_name.c_str());
+}
+BENCHMARK(BM_read_log)->Arg(10000)->Arg(1000000);
+
+static void BM_sort(benchmark::State &state)
+{
+    auto const file_name = write_log(static_cast<std::size_t>(state.range(0)));
+    auto objects = read_log(".", file_name);
+    std::remove(file_name.c_str());
+
+    std::mt19937 gen{42};
+    std::shuffle(objects.begin(), objects.end(), gen);
+
+    {
+        AllocationCounter counter{state};
+        for (auto _ : state) {
+            state.PauseTiming();
+            auto copy = objects;
+            state.ResumeTiming();
+            std::sort(copy.begin(), copy.end());
+            benchmark::DoNotOptimize(copy.data());
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_sort)->Arg(10000)->Arg(1000000);
+
+/**
+ * Create a sorted list of (id, version) pairs like the database returns in
+ * fake-log with the specified number of entries. Every second entry is also
+ * put into the done list.
+ */
+static void create_id_lists(std::size_t num,
+                            std::vector<id_version_type> &rows,
+                            std::vector<id_version_type> &done)
+{
+    std::mt19937 gen{42};
+    std::uniform_int_distribution<int> version_dist{1, 5};
+
+    osmium::object_id_type id = 1000000;
+    for (std::size_t i = 0; i < num; ++i) {
+        id += 1 + gen() % 100;
+        rows.emplace_back(id, version_dist(gen));
+        if (i % 2 == 0) {
+            done.push_back(rows.back());
+        }
+    }
+}
+
+/// Filter with std::set lookups like fake-log used to do.
+static void BM_filter_set(benchmark::State &state)
+{
+    std::vector<id_version_type> rows;
+    std::vector<id_version_type> done;
+    create_id_lists(static_cast<std::size_t>(state.range(0)), rows, done);
+
+    {
+        AllocationCounter counter{state};
+        for (auto _ : state) {
+            std::set<id_version_type> const done_set(done.begin(), done.end());
+            std::size_t count = 0;
+            for (auto const &row : rows) {
+                if (!done_set.count(row)) {
+                    ++count;
+                }
+            }
+            benchmark::DoNotOptimize(count);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_filter_set)->Arg(10000)->Arg(1000000);
+
+/// Filter with an IdFilter over a sorted vector like fake-log does now.
+static void BM_filter_sorted(benchmark::State &state)
+{
+    std::vector<id_version_type> rows;
+    std::vector<id_version_type> done;
+    create_id_lists(static_cast<std::size_t>(state.range(0)), rows, done);
+
+    {
+        AllocationCounter counter{state};
+        for (auto _ : state) {
+            auto done_list = done;
+            sort_unique(done_list);
+            IdFilter filter{done_list};
+            std::size_t count = 0;
+            for (auto const &row : rows) {
+                if (!filter.contains(row)) {
+                    ++count;
+                }
+            }
+            benchmark::DoNotOptimize(count);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_filter_sorted)->Arg(10000)->Arg(1000000);
+
+static FakeRow object_row(char type)
+{
+    FakeRow row{FakeField{"123456789"}, FakeField{"3"}, FakeField{"1234"},
+                FakeField{"t"}, FakeField{"1582230020"}};
+    if (type == 'n') {
+        row.emplace_back("1234567890");
+        row.emplace_back("-123456789");
+    }
+    return row;
+}
+
+static FakeResult tag_rows(std::size_t num)
+{
+    FakeResult rows;
+    for (std::size_t i = 0; i < num; ++i) {
+        rows.push_back(FakeRow{FakeField{"key" + std::to_string(i)},
+                               FakeField{"some value"}});
+    }
+    return rows;
+}
+
+static FakeResult list_rows(char type, std::size_t num)
+{
+    FakeResult rows;
+    for (std::size_t i = 0; i < num; ++i) {
+        if (type == 'w') {
+            rows.push_back(FakeRow{FakeField{std::to_string(1000000000 + i)}});
+        } else if (type == 'r') {
+            rows.push_back(FakeRow{FakeField{i % 10 ? "Way" : "Node"},
+                                   FakeField{std::to_string(100000000 + i)},
+                                   FakeField{i % 10 ? "outer" : "label"}});
+        }
+    }
+    return rows;
+}
+
+/**
+ * Build objects of the type given as first argument with the number of
+ * tags in the second argument and the number of way nodes or members in
+ * the third argument into a buffer like create-diff does.
+ */
+static void BM_build(benchmark::State &state)
+{
+    char const type = static_cast<char>(state.range(0));
+    auto const num_tags = static_cast<std::size_t>(state.range(1));
+    auto const num_list = static_cast<std::size_t>(state.range(2));
+
+    std::string const id{std::string(1, type) + "123456789"};
+    osmobj const obj{id, "v3", "c1234"};
+
+    changeset_user_lookup cucache;
+    cucache[1234].id = 42;
+    cucache[1234].username = "some user";
+
+    auto const row = object_row(type);
+    auto const tags = tag_rows(num_tags);
+    auto const list = list_rows(type, num_list);
+
+    std::size_t const buffer_size = 1024 * 1024;
+    osmium::memory::Buffer buffer{buffer_size};
+
+    {
+        AllocationCounter counter{state};
+        for (auto _ : state) {
+            obj.build(buffer, cucache, row, tags, list);
+            if (buffer.committed() > buffer_size - 100 * 1024) {
+                buffer.clear();
+            }
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_build)
+    ->Args({'n', 0, 0})
+    ->Args({'n', 5, 0})
+    ->Args({'w', 3, 20})
+    ->Args({'w', 3, 2000})
+    ->Args({'r', 5, 100})
+    ->Args({'r', 5, 10000});
+
+static FakeResult list_arrays(char type, std::size_t num)
+{
+    std::string ids{"{"};
+    std::string types{"{"};
+    std::string roles{"{"};
+    for (std::size_t i = 0; i < num; ++i) {
+        if (i > 0) {
+            ids += ',';
+            types += ',';
+            roles += ',';
+        }
+        ids += std::to_string((type == 'w' ? 1000000000 : 100000000) + i);
+        types += i % 10 ? "Way" : "Node";
+        roles += i % 10 ? "outer" : "label";
+    }
+    ids += '}';
+    types += '}';
+    roles += '}';
+
+    if (type == 'w') {
+        return FakeResult{FakeRow{FakeField{ids}}};
+    }
+    return FakeResult{
+        FakeRow{FakeField{types}, FakeField{ids}, FakeField{roles}}};
+}
+
+/// Like BM_build but with way nodes and members in arrays.
+static void BM_build_arrays(benchmark::State &state)
+{
+    char const type = static_cast<char>(state.range(0));
+    auto const num_tags = static_cast<std::size_t>(state.range(1));
+    auto const num_list = static_cast<std::size_t>(state.range(2));
+
+    std::string const id{std::string(1, type) + "123456789"};
+    osmobj const obj{id, "v3", "c1234"};
+
+    changeset_user_lookup cucache;
+    cucache[1234].id = 42;
+    cucache[1234].username = "some user";
+
+    auto const row = object_row(type);
+    auto const tags = tag_rows(num_tags);
+    auto const list = list_arrays(type, num_list);
+
+    std::size_t const buffer_size = 1024 * 1024;
+    osmium::memory::Buffer buffer{buffer_size};
+
+    {
+        AllocationCounter counter{state};
+        for (auto _ : state) {
+            obj.build(buffer, cucache, row, tags, list, fetch_mode::arrays);
+            if (buffer.committed() > buffer_size - 100 * 1024) {
+                buffer.clear();
+            }
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_build_arrays)
+    ->Args({'w', 3, 20})
+    ->Args({'w', 3, 2000})
+    ->Args({'r', 5, 100})
+    ->Args({'r', 5, 10000});
+
+/// Like BM_build but with the whole object in one row of a composite query.
+static void BM_build_composite(benchmark::State &state)
+{
+    char const type = static_cast<char>(state.range(0));
+    auto const num_tags = static_cast<std::size_t>(state.range(1));
+    auto const num_list = static_cast<std::size_t>(state.range(2));
+
+    userinfo user;
+    user.id = 42;
+    user.username = "some user";
+
+    std::string keys{"{"};
+    std::string vals{"{"};
+    for (std::size_t i = 0; i < num_tags; ++i) {
+        if (i > 0) {
+            keys += ',';
+            vals += ',';
+        }
+        keys += "key" + std::to_string(i);
+        vals += "\"some value\"";
+    }
+    keys += '}';
+    vals += '}';
+
+    auto row = object_row(type);
+    row.emplace_back(keys);
+    row.emplace_back(vals);
+    if (type != 'n') {
+        for (auto const &field : list_arrays(type, num_list)[0]) {
+            row.push_back(field);
+        }
+    }
+
+    osmium::item_type const item_type = osmium::char_to_item_type(type);
+
+    std::size_t const buffer_size = 1024 * 1024;
+    osmium::memory::Buffer buffer{buffer_size};
+
+    {
+        AllocationCounter counter{state};
+        for (auto _ : state) {
+            osmobj::build_composite(item_type, buffer, row, user);
+            if (buffer.committed() > buffer_size - 100 * 1024) {
+                buffer.clear();
+            }
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_build_composite)
+    ->Args({'n', 0, 0})
+    ->Args({'n', 5, 0})
+    ->Args({'w', 3, 20})
+    ->Args({'w', 3, 2000})
+    ->Args({'r', 5, 100})
+    ->Args({'r', 5, 10000});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,91 @@
+
+#include "array.hpp"
+#include "exception.hpp"
+
+ArrayReader::ArrayReader(char const *str) : m_pos(str)
+{
+    if (m_pos == nullptr || *m_pos == '\0') {
+        m_pos = nullptr;
+        return;
+    }
+
+    if (*m_pos != '{') {
+        throw database_error{"Expected array."};
+    }
+    ++m_pos;
+
+    if (*m_pos == '}') {
+        m_pos = nullptr;
+    }
+}
+
+void ArrayReader::advance()
+{
+    if (*m_pos == ',') {
+        ++m_pos;
+    } else if (*m_pos == '}') {
+        m_pos = nullptr;
+    } else {
+        throw database_error{"Invalid array format."};
+    }
+}
+
+bool ArrayReader::next(std::string &value)
+{
+    if (at_end()) {
+        return false;
+    }
+
+    value.clear();
+    if (*m_pos == '"') {
+        ++m_pos;
+        while (*m_pos != '"') {
+            if (*m_pos == '\\') {
+                ++m_pos;
+            }
+            if (*m_pos == '\0') {
+                throw database_error{"Unterminated string in array."};
+            }
+            value += *m_pos++;
+        }
+        ++m_pos;
+    } else {
+        char const *const start = m_pos;
+        while (*m_pos != ',' && *m_pos != '}') {
+            if (*m_pos == '\0') {
+                throw database_error{"Unterminated array."};
+            }
+            ++m_pos;
+        }
+        value.assign(start, m_pos);
+    }
+
+    advance();
+    return true;
+}
+
+bool ArrayReader::next_int(std::int64_t &value)
+{
+    if (at_end()) {
+        return false;
+    }
+
+    bool const negative = *m_pos == '-';
+    if (negative) {
+        ++m_pos;
+    }
+
+    if (*m_pos < '0' || *m_pos > '9') {
+        throw database_error{"Expected integer in array."};
+    }
+
+    std::int64_t result = 0;
+    while (*m_pos >= '0' && *m_pos <= '9') {
+        result = result * 10 + (*m_pos - '0');
+        ++m_pos;
+    }
+    value = negative ? -result : result;
+
+    advance();
+    return true;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Reads the elements of a one-dimensional PostgreSQL array in text format
+ * (like '{1,2,3}' or '{a,"b c"}') one by one without allocating memory for
+ * each element. An empty string (which is what a NULL array is returned
+ * as) is treated as an empty array. NULL elements are not supported, they
+ * are returned as the string "NULL".
+ */
+class ArrayReader
+{
+public:
+    explicit ArrayReader(char const *str);
+
+    /// Read the next element into value. Returns false at the end.
+    bool next(std::string &value);
+
+    /// Read the next element as integer. Returns false at the end.
+    bool next_int(std::int64_t &value);
+
+    bool at_end() const noexcept { return m_pos == nullptr; }
+
+private:
+    void advance();
+
+    char const *m_pos;
+}; // class ArrayReader
@@ -34,6 +34,40 @@ static void build_conn_str(std::string &str, char const *key,
     str += val;
 }
 
+static region_config parse_region(YAML::Node const &node)
+{
+    if (!node.IsMap()) {
+        throw config_error{"Each entry in 'regions' must be a Map."};
+    }
+
+    region_config region;
+    if (node["name"]) {
+        region.name = node["name"].as<std::string>();
+    }
+    if (region.name.empty() ||
+        region.name.find_first_of("/.") != std::string::npos) {
+        throw config_error{"Region needs a 'name' without '/' or '.'."};
+    }
+
+    auto const &bbox = node["bbox"];
+    if (!bbox || !bbox.IsSequence() || bbox.size() != 4) {
+        throw config_error{"Region '" + region.name +
+                           "' needs a 'bbox' with four numbers."};
+    }
+
+    osmium::Location const bottom_left{bbox[0].as<double>(),
+                                       bbox[1].as<double>()};
+    osmium::Location const top_right{bbox[2].as<double>(),
+                                     bbox[3].as<double>()};
+    if (!bottom_left.valid() || !top_right.valid() ||
+        bottom_left.x() > top_right.x() || bottom_left.y() > top_right.y()) {
+        throw config_error{"Region '" + region.name + "' has invalid 'bbox'."};
+    }
+    region.box = osmium::Box{bottom_left, top_right};
+
+    return region;
+}
+
 static YAML::Node load_config_file(std::string const &config_file)
 {
     std::ifstream stream{config_file};
@@ -77,6 +111,19 @@ Config::Config(std::string const &config_file, osmium::VerboseOutput &vout)
         m_run_dir = m_config["run_dir"].as<std::string>();
     }
 
+    if (m_config["metrics_dir"]) {
+        m_metrics_dir = m_config["metrics_dir"].as<std::string>();
+    }
+
+    if (m_config["regions"]) {
+        if (!m_config["regions"].IsSequence()) {
+            throw config_error{"'regions' entry must be a Sequence."};
+        }
+        for (auto const &node : m_config["regions"]) {
+            m_regions.push_back(parse_region(node));
+        }
+    }
+
     build_conn_str(m_db_connection, "host", m_db_host);
     build_conn_str(m_db_connection, "port", m_db_port);
     build_conn_str(m_db_connection, "dbname", m_db_dbname);
@@ -94,6 +141,12 @@ Config::Config(std::string const &config_file, osmium::VerboseOutput &vout)
     vout << "  Directory for log files: " << m_log_dir << '\n';
     vout << "  Directory for change files: " << m_changes_dir << '\n';
     vout << "  Directory for run files: " << m_run_dir << '\n';
+    vout << "  Directory for metrics files: "
+         << (m_metrics_dir.empty() ? "(not set)" : m_metrics_dir) << '\n';
+    vout << "  Regions: " << m_regions.size() << '\n';
+    for (auto const &region : m_regions) {
+        vout << "    " << region.name << ": " << region.box << '\n';
+    }
 }
 
 std::string const &Config::db_connection() const noexcept
@@ -114,3 +167,13 @@ std::string const &Config::changes_dir() const noexcept
 }
 
 std::string const &Config::run_dir() const noexcept { return m_run_dir; }
+
+std::string const &Config::metrics_dir() const noexcept
+{
+    return m_metrics_dir;
+}
+
+std::vector<region_config> const &Config::regions() const noexcept
+{
+    return m_regions;
+}
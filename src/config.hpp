@@ -2,9 +2,18 @@
 
 #include <yaml-cpp/yaml.h>
 
+#include <osmium/osm/box.hpp>
 #include <osmium/util/verbose_output.hpp>
 
 #include <string>
+#include <vector>
+
+/// A named region (currently only a bounding box) for regional diffs.
+struct region_config
+{
+    std::string name;
+    osmium::Box box;
+};
 
 class Config
 {
@@ -17,6 +26,8 @@ public:
     std::string const &log_dir() const noexcept;
     std::string const &changes_dir() const noexcept;
     std::string const &run_dir() const noexcept;
+    std::string const &metrics_dir() const noexcept;
+    std::vector<region_config> const &regions() const noexcept;
 
 private:
     YAML::Node m_config;
@@ -33,4 +44,6 @@ private:
     std::string m_log_dir{"/tmp"};
     std::string m_changes_dir{"/tmp"};
     std::string m_run_dir{"/tmp"};
+    std::string m_metrics_dir{};
+    std::vector<region_config> m_regions{};
 }; // class Config
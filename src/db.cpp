@@ -5,7 +5,7 @@
 #include <cstring>
 #include <stdexcept>
 
-std::string get_db_version(pqxx::work &txn)
+std::string get_db_version(pqxx::transaction_base &txn)
 {
     pqxx::result const result = txn.exec("SELECT * FROM version();");
     if (result.size() != 1) {
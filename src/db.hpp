@@ -1,9 +1,23 @@
 #pragma once
 
+#include "timings.hpp"
+
 #include <pqxx/pqxx>
 #include <string>
 
-std::string get_db_version(pqxx::work &txn);
+std::string get_db_version(pqxx::transaction_base &txn);
 
 void catchup_to_lsn(pqxx::work &txn, std::string const &replication_slot,
                     std::string const &lsn);
+
+/**
+ * Execute a prepared statement invocation like
+ * txn.prepared("name")(param1)(param2). The latency is recorded in the
+ * statement timings under the specified name.
+ */
+template <typename TInvocation>
+pqxx::result exec_timed(char const *name, TInvocation const &invocation)
+{
+    StatementTimer timer{name};
+    return invocation.exec();
+}
@@ -0,0 +1,125 @@
+#include "expire.hpp"
+#include "exception.hpp"
+
+#include <osmium/geom/tile.hpp>
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/way.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <utility>
+
+static uint32_t parse_zoom(std::string const &str)
+{
+    char *end = nullptr;
+    auto const zoom = std::strtoul(str.c_str(), &end, 10);
+    if (str.empty() || *end != '\0' || zoom > TileExpiry::max_zoom) {
+        throw argument_error{"Invalid zoom level '" + str +
+                             "' (must be between 0 and " +
+                             std::to_string(TileExpiry::max_zoom) + ")"};
+    }
+    return static_cast<uint32_t>(zoom);
+}
+
+std::vector<uint32_t> parse_zoom_levels(std::string const &str)
+{
+    std::vector<uint32_t> zooms;
+
+    std::string::size_type pos = 0;
+    while (pos <= str.size()) {
+        auto end = str.find(',', pos);
+        if (end == std::string::npos) {
+            end = str.size();
+        }
+        std::string const part{str.substr(pos, end - pos)};
+        auto const dash = part.find('-');
+        if (dash == std::string::npos) {
+            zooms.push_back(parse_zoom(part));
+        } else {
+            auto const from = parse_zoom(part.substr(0, dash));
+            auto const to = parse_zoom(part.substr(dash + 1));
+            if (from > to) {
+                throw argument_error{"Invalid zoom range '" + part + "'"};
+            }
+            for (auto zoom = from; zoom <= to; ++zoom) {
+                zooms.push_back(zoom);
+            }
+        }
+        pos = end + 1;
+    }
+
+    std::sort(zooms.begin(), zooms.end());
+    zooms.erase(std::unique(zooms.begin(), zooms.end()), zooms.end());
+
+    return zooms;
+}
+
+TileExpiry::TileExpiry(std::vector<uint32_t> zooms) : m_zooms(std::move(zooms))
+{
+    assert(!m_zooms.empty());
+    assert(m_zooms.back() <= max_zoom);
+}
+
+void TileExpiry::add_location(osmium::Location location)
+{
+    if (!location.valid()) {
+        return;
+    }
+
+    osmium::geom::Tile const tile{m_zooms.back(), location};
+    uint64_t const value = (static_cast<uint64_t>(tile.x) << 32U) | tile.y;
+
+    // neighbouring way nodes are often in the same tile
+    if (m_tiles.empty() || m_tiles.back() != value) {
+        m_tiles.push_back(value);
+    }
+}
+
+void TileExpiry::add_object(osmium::OSMObject const &object)
+{
+    switch (object.type()) {
+    case osmium::item_type::node:
+        add_location(static_cast<osmium::Node const &>(object).location());
+        break;
+    case osmium::item_type::way:
+        for (auto const &node_ref :
+             static_cast<osmium::Way const &>(object).nodes()) {
+            add_location(node_ref.location());
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+std::string TileExpiry::list()
+{
+    std::sort(m_tiles.begin(), m_tiles.end());
+    m_tiles.erase(std::unique(m_tiles.begin(), m_tiles.end()), m_tiles.end());
+
+    std::string result;
+    std::vector<uint64_t> tiles;
+    for (auto const zoom : m_zooms) {
+        auto const shift = m_zooms.back() - zoom;
+        tiles.clear();
+        for (auto const value : m_tiles) {
+            uint64_t const x = (value >> 32U) >> shift;
+            uint64_t const y = (value & 0xffffffffU) >> shift;
+            tiles.push_back((x << 32U) | y);
+        }
+        std::sort(tiles.begin(), tiles.end());
+        tiles.erase(std::unique(tiles.begin(), tiles.end()), tiles.end());
+
+        for (auto const value : tiles) {
+            result += std::to_string(zoom);
+            result += '/';
+            result += std::to_string(value >> 32U);
+            result += '/';
+            result += std::to_string(value & 0xffffffffU);
+            result += '\n';
+        }
+    }
+
+    return result;
+}
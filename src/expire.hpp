@@ -0,0 +1,54 @@
+#pragma once
+
+#include <osmium/osm/location.hpp>
+#include <osmium/osm/object.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Parse a list of zoom levels like "12,14" or "10-14" (or a mix of both)
+ * as used in the --expire-tiles option. Returns the zoom levels sorted
+ * and without duplicates. Throws argument_error if the list is invalid.
+ */
+std::vector<uint32_t> parse_zoom_levels(std::string const &str);
+
+/**
+ * Collects the web mercator tiles touched by changed objects. Tiles are
+ * only recorded on the highest zoom level, tiles on lower zoom levels are
+ * derived from them when the list is created.
+ */
+class TileExpiry
+{
+public:
+    static constexpr uint32_t max_zoom = 20;
+
+    /// The zoom levels must be sorted and not larger than max_zoom.
+    explicit TileExpiry(std::vector<uint32_t> zooms);
+
+    /// Expire the tile containing the location. Invalid locations are
+    /// ignored.
+    void add_location(osmium::Location location);
+
+    /**
+     * Expire the tiles containing the location of a node or the locations
+     * of all nodes of a way. Way node locations must have been set.
+     * Relations are ignored.
+     */
+    void add_object(osmium::OSMObject const &object);
+
+    /**
+     * Return the list of expired tiles, one "z/x/y" per line, sorted by
+     * zoom level, x, and y.
+     */
+    std::string list();
+
+private:
+    std::vector<uint32_t> m_zooms;
+
+    // tiles on the highest zoom level with x in the upper and y in the
+    // lower 32 bits
+    std::vector<uint64_t> m_tiles;
+
+}; // class TileExpiry
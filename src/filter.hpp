@@ -0,0 +1,47 @@
+#pragma once
+
+#include <osmium/osm/types.hpp>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+using id_version_type =
+    std::pair<osmium::object_id_type, osmium::object_version_type>;
+
+/// Sort the list and remove duplicates so it can be used in an IdFilter.
+inline void sort_unique(std::vector<id_version_type> &list)
+{
+    std::sort(list.begin(), list.end());
+    list.erase(std::unique(list.begin(), list.end()), list.end());
+}
+
+/**
+ * Checks whether (id, version) pairs are in a sorted list. The pairs
+ * checked must be sorted, too, then this can be done by walking through
+ * both lists in parallel without any lookups. The list must outlive the
+ * filter.
+ */
+class IdFilter
+{
+public:
+    explicit IdFilter(std::vector<id_version_type> const &list) noexcept
+    : m_it(list.cbegin()), m_end(list.cend())
+    {}
+
+    /**
+     * Is the value in the list? The value must not be smaller than any
+     * value given in a previous call.
+     */
+    bool contains(id_version_type const &value) noexcept
+    {
+        while (m_it != m_end && *m_it < value) {
+            ++m_it;
+        }
+        return m_it != m_end && *m_it == value;
+    }
+
+private:
+    std::vector<id_version_type>::const_iterator m_it;
+    std::vector<id_version_type>::const_iterator m_end;
+}; // class IdFilter
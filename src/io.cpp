@@ -1,8 +1,13 @@
 
 #include "io.hpp"
+#include "util.hpp"
 
 #include <osmium/io/detail/read_write.hpp>
 
+#include <algorithm>
+#include <cerrno>
+
+#include <dirent.h>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -49,6 +54,69 @@ void sync_dir(std::string const &dir_name)
     }
 }
 
+/**
+ * Return the names of all entries in the directory except "." and "..",
+ * sorted alphabetically.
+ */
+std::vector<std::string> list_dir(std::string const &dir_name)
+{
+    DIR *dir = ::opendir(dir_name.c_str());
+    if (!dir) {
+        throw std::system_error{errno, std::system_category(),
+                                "Opening directory '" + dir_name + "' failed"};
+    }
+
+    std::vector<std::string> names;
+    while (dirent const *entry = ::readdir(dir)) {
+        std::string name{entry->d_name};
+        if (name != "." && name != "..") {
+            names.push_back(std::move(name));
+        }
+    }
+    ::closedir(dir);
+
+    std::sort(names.begin(), names.end());
+
+    return names;
+}
+
+/**
+ * Create the directory if it doesn't exist already. The parent directory
+ * must exist. The parent directory is synced after the directory was
+ * created.
+ */
+void create_dir(std::string const &dir_name)
+{
+    if (::mkdir(dir_name.c_str(), 0777) != 0) {
+        if (errno == EEXIST) {
+            return;
+        }
+        std::string msg{"Creating directory failed for '"};
+        msg += dir_name;
+        msg += "'";
+        throw std::system_error{errno, std::system_category(), msg};
+    }
+
+    auto const pos = dir_name.find_last_of('/');
+    sync_dir(pos == std::string::npos ? "." : dir_name.substr(0, pos + 1));
+}
+
+bool file_exists(std::string const &path)
+{
+    struct stat st; // NOLINT(cppcoreguidelines-pro-type-member-init,hicpp-member-init)
+    return ::stat(path.c_str(), &st) == 0;
+}
+
+std::time_t file_mtime(std::string const &path)
+{
+    struct stat st; // NOLINT(cppcoreguidelines-pro-type-member-init,hicpp-member-init)
+    if (::stat(path.c_str(), &st) != 0) {
+        throw std::system_error{errno, std::system_category(),
+                                "Can not stat file '" + path + "'"};
+    }
+    return st.st_mtime;
+}
+
 PIDFile::PIDFile(std::string const &dir, std::string const &name)
 {
     if (dir.empty()) {
@@ -83,3 +151,141 @@ PIDFile::~PIDFile()
         ::unlink(m_path.c_str());
     }
 }
+
+/// Can unnamed files be linked into the file system through /proc?
+static bool can_link_unnamed_files()
+{
+#ifdef O_TMPFILE
+    static bool const result = ::access("/proc/self/fd", F_OK) == 0;
+    return result;
+#else
+    return false;
+#endif
+}
+
+DurableWriter::~DurableWriter() noexcept
+{
+    for (auto const &e : m_entries) {
+        if (e.fd >= 0) {
+            ::close(e.fd);
+        }
+        if (e.owned) {
+            ::unlink(e.tmp_name.c_str());
+        }
+    }
+}
+
+void DurableWriter::add_data(std::string const &file_name,
+                             std::string const &data)
+{
+    entry e;
+    e.file_name = file_name;
+
+#ifdef O_TMPFILE
+    if (can_link_unnamed_files()) {
+        e.fd = ::open(dirname(file_name).c_str(),
+                      O_TMPFILE | O_WRONLY | O_CLOEXEC, // NOLINT(hicpp-signed-bitwise)
+                      0666);
+        // Not all file systems support O_TMPFILE, fall back to a named
+        // temporary file on those.
+        if (e.fd < 0 && errno != EOPNOTSUPP && errno != EISDIR &&
+            errno != EINVAL) {
+            throw std::system_error{errno, std::system_category(),
+                                    "Can not create file in directory of '" +
+                                        file_name + "'"};
+        }
+    }
+#endif
+
+    if (e.fd < 0) {
+        e.tmp_name = file_name + ".new";
+        e.fd = osmium::io::detail::open_for_writing(e.tmp_name,
+                                                    osmium::io::overwrite::no);
+        e.owned = true;
+    }
+
+    m_entries.push_back(e);
+    osmium::io::detail::reliable_write(e.fd, data.data(), data.size());
+}
+
+void DurableWriter::add_file(std::string const &tmp_name,
+                             std::string const &file_name)
+{
+    entry e;
+    e.tmp_name = tmp_name;
+    e.file_name = file_name;
+    m_entries.push_back(e);
+}
+
+void DurableWriter::link_into_place(entry const &e)
+{
+    std::string const fd_path{"/proc/self/fd/" + std::to_string(e.fd)};
+
+    // linkat() doesn't replace existing files, in that case link to a
+    // temporary name first and rename that.
+    if (::linkat(AT_FDCWD, fd_path.c_str(), AT_FDCWD, e.file_name.c_str(),
+                 AT_SYMLINK_FOLLOW) == 0) {
+        return;
+    }
+    if (errno == EEXIST) {
+        std::string const tmp_name{e.file_name + ".new"};
+        ::unlink(tmp_name.c_str());
+        if (::linkat(AT_FDCWD, fd_path.c_str(), AT_FDCWD, tmp_name.c_str(),
+                     AT_SYMLINK_FOLLOW) == 0) {
+            rename_file(tmp_name, e.file_name);
+            return;
+        }
+    }
+
+    throw std::system_error{errno, std::system_category(),
+                            "Linking file '" + e.file_name + "' failed"};
+}
+
+void DurableWriter::commit()
+{
+    for (auto &e : m_entries) {
+        if (e.fd < 0) {
+            e.fd = ::open(e.tmp_name.c_str(),
+                          O_RDONLY | O_CLOEXEC); // NOLINT(hicpp-signed-bitwise)
+            if (e.fd < 0) {
+                throw std::system_error{errno, std::system_category(),
+                                        "Can not open file '" + e.tmp_name +
+                                            "'"};
+            }
+        }
+#ifdef SYNC_FILE_RANGE_WRITE
+        // Start writeback of all files before waiting for the first one,
+        // so the disk can handle them in one go.
+        ::sync_file_range(e.fd, 0, 0, SYNC_FILE_RANGE_WRITE);
+#endif
+    }
+
+    for (auto &e : m_entries) {
+        osmium::io::detail::reliable_fsync(e.fd);
+        ++m_file_syncs;
+    }
+
+    std::vector<std::string> dir_names;
+    for (auto &e : m_entries) {
+        if (e.tmp_name.empty()) {
+            link_into_place(e);
+        } else {
+            rename_file(e.tmp_name, e.file_name);
+            e.owned = false;
+        }
+        osmium::io::detail::reliable_close(e.fd);
+        e.fd = -1;
+
+        auto dir_name = dirname(e.file_name);
+        if (std::find(dir_names.begin(), dir_names.end(), dir_name) ==
+            dir_names.end()) {
+            dir_names.push_back(std::move(dir_name));
+        }
+    }
+    m_entries.clear();
+
+    for (auto const &dir_name : dir_names) {
+        sync_dir(dir_name);
+        ++m_dir_syncs;
+    }
+}
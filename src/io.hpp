@@ -1,9 +1,16 @@
 #pragma once
 
+#include <cstddef>
+#include <ctime>
 #include <string>
+#include <vector>
 
 void rename_file(std::string const &old_name, std::string const &new_name);
 void sync_dir(std::string const &dir_name);
+void create_dir(std::string const &dir_name);
+std::vector<std::string> list_dir(std::string const &dir_name);
+bool file_exists(std::string const &path);
+std::time_t file_mtime(std::string const &path);
 
 class PIDFile
 {
@@ -15,3 +22,66 @@ private:
     std::string m_path;
 
 }; // class PIDFile
+
+/**
+ * Writes files durably and atomically, grouping the syncs needed for that.
+ *
+ * Files added are only visible under their final names after commit(). It
+ * first syncs the contents of all files, then moves them into place in the
+ * order they were added and syncs each directory involved once. Use one
+ * commit() for files that can be published together and separate ones if
+ * one file must be durable before another one becomes visible (for instance
+ * a diff and the state.txt referring to it).
+ *
+ * Where supported, files with data added through add_data() are created
+ * without a name (O_TMPFILE) and linked into place, so no partially written
+ * files are left over on a crash. Otherwise a temporary file with the
+ * suffix ".new" is used.
+ */
+class DurableWriter
+{
+public:
+    DurableWriter() = default;
+
+    DurableWriter(DurableWriter const &) = delete;
+    DurableWriter &operator=(DurableWriter const &) = delete;
+
+    DurableWriter(DurableWriter &&) = delete;
+    DurableWriter &operator=(DurableWriter &&) = delete;
+
+    ~DurableWriter() noexcept;
+
+    /// Write data to a file which will replace file_name on commit().
+    void add_data(std::string const &file_name, std::string const &data);
+
+    /**
+     * Publish the already written (but not necessarily synced) file
+     * tmp_name as file_name on commit().
+     */
+    void add_file(std::string const &tmp_name, std::string const &file_name);
+
+    /// Sync and publish all files added since the last commit().
+    void commit();
+
+    /// Number of files synced.
+    std::size_t file_syncs() const noexcept { return m_file_syncs; }
+
+    /// Number of directories synced.
+    std::size_t dir_syncs() const noexcept { return m_dir_syncs; }
+
+private:
+    struct entry
+    {
+        int fd = -1;
+        std::string tmp_name; // empty for unnamed files
+        std::string file_name;
+        bool owned = false; // tmp_name created by us
+    };
+
+    void link_into_place(entry const &e);
+
+    std::vector<entry> m_entries;
+    std::size_t m_file_syncs = 0;
+    std::size_t m_dir_syncs = 0;
+
+}; // class DurableWriter
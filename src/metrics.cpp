@@ -0,0 +1,67 @@
+
+#include "metrics.hpp"
+#include "util.hpp"
+
+#include <cstdio>
+
+void Metrics::describe(char const *name, char const *help, char const *type)
+{
+    m_data += "# HELP ";
+    m_data += name;
+    m_data += ' ';
+    m_data += help;
+    m_data += "\n# TYPE ";
+    m_data += name;
+    m_data += ' ';
+    m_data += type;
+    m_data += '\n';
+}
+
+void Metrics::add(char const *name, double value, std::string const &labels)
+{
+    m_data += name;
+    if (!labels.empty()) {
+        m_data += '{';
+        m_data += labels;
+        m_data += '}';
+    }
+
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), " %.15g\n", value);
+    m_data += buffer;
+}
+
+void Metrics::gauge(char const *name, char const *help, double value,
+                    std::string const &labels)
+{
+    describe(name, help);
+    add(name, value, labels);
+}
+
+void Metrics::write(std::string const &dir_name, std::string const &name) const
+{
+    write_data_to_file(m_data, dir_name, "/" + name + ".prom");
+}
+
+std::string metrics_label(char const *key, std::string const &value)
+{
+    std::string label{key};
+    label += "=\"";
+    for (char const c : value) {
+        switch (c) {
+        case '\\':
+            label += "\\\\";
+            break;
+        case '"':
+            label += "\\\"";
+            break;
+        case '\n':
+            label += "\\n";
+            break;
+        default:
+            label += c;
+        }
+    }
+    label += '"';
+    return label;
+}
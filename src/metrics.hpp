@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Collects metrics in the Prometheus text exposition format. The result
+ * can be written to a "*.prom" file which is picked up by the textfile
+ * collector of the Prometheus node exporter.
+ */
+class Metrics
+{
+public:
+    /// Add HELP and TYPE lines for a metric.
+    void describe(char const *name, char const *help,
+                  char const *type = "gauge");
+
+    /// Add a sample for a metric. Labels are created with metrics_label().
+    void add(char const *name, double value,
+             std::string const &labels = std::string{});
+
+    /// Describe a gauge metric and add a single sample.
+    void gauge(char const *name, char const *help, double value,
+               std::string const &labels = std::string{});
+
+    std::string const &data() const noexcept { return m_data; }
+
+    /// Atomically write metrics to the file "DIR/NAME.prom".
+    void write(std::string const &dir_name, std::string const &name) const;
+
+private:
+    std::string m_data;
+}; // class Metrics
+
+/**
+ * Create a label in the form key="value" with the value properly escaped.
+ * Append several labels with a ',' in between.
+ */
+std::string metrics_label(char const *key, std::string const &value);
@@ -0,0 +1,288 @@
+
+#include "config.hpp"
+#include "exception.hpp"
+#include "io.hpp"
+#include "metrics.hpp"
+#include "options.hpp"
+#include "util.hpp"
+
+#include <osmium/util/verbose_output.hpp>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+class BackfillOptions : public Options
+{
+public:
+    BackfillOptions()
+    : Options("backfill",
+              "Create diffs for all pending log files in parallel.")
+    {}
+
+    std::size_t jobs() const noexcept { return m_jobs; }
+
+    std::string const &create_diff() const noexcept { return m_create_diff; }
+
+    std::vector<std::string> const &create_diff_options() const noexcept
+    {
+        return m_create_diff_options;
+    }
+
+private:
+    void add_command_options(po::options_description &desc) override
+    {
+        po::options_description opts_cmd{"COMMAND OPTIONS"};
+
+        // clang-format off
+        opts_cmd.add_options()
+            ("jobs,j", po::value<std::size_t>(), "Number of parallel osmdbt-create-diff processes (default: 4)")
+            ("create-diff", po::value<std::string>(), "Path of the osmdbt-create-diff program (default: search in PATH)")
+            ("option,O", po::value<std::vector<std::string>>(), "Pass this option to osmdbt-create-diff");
+        // clang-format on
+
+        desc.add(opts_cmd);
+    }
+
+    void check_command_options(
+        boost::program_options::variables_map const &vm) override
+    {
+        if (vm.count("jobs")) {
+            m_jobs = vm["jobs"].as<std::size_t>();
+            if (m_jobs == 0) {
+                throw argument_error{"Number of jobs must be at least 1"};
+            }
+        }
+
+        if (vm.count("create-diff")) {
+            m_create_diff = vm["create-diff"].as<std::string>();
+        }
+
+        if (vm.count("option")) {
+            m_create_diff_options =
+                vm["option"].as<std::vector<std::string>>();
+        }
+    }
+
+    std::size_t m_jobs = 4;
+    std::string m_create_diff{"osmdbt-create-diff"};
+    std::vector<std::string> m_create_diff_options;
+
+}; // class BackfillOptions
+
+/// Name of the change file created by osmdbt-create-diff for a log file.
+static std::string diff_file_name(Config const &config,
+                                  std::string const &log_file_name)
+{
+    return replace_suffix(config.changes_dir() + "/" + log_file_name, "") +
+           ".osc.gz";
+}
+
+/**
+ * Find all log files without change file in the log directory. They are
+ * returned ordered by LSN. Log files without LSN (from osmdbt-fake-log) are
+ * sorted first, ordered by name (and so by creation time).
+ */
+static std::vector<std::string> find_pending_logs(Config const &config)
+{
+    std::vector<std::pair<std::uint64_t, std::string>> logs;
+
+    for (auto const &name : list_dir(config.log_dir())) {
+        if (is_log_file_name(name) &&
+            !file_exists(diff_file_name(config, name))) {
+            logs.emplace_back(lsn_from_log_file_name(name), name);
+        }
+    }
+
+    std::sort(logs.begin(), logs.end());
+
+    std::vector<std::string> names;
+    for (auto const &log : logs) {
+        names.push_back(log.second);
+    }
+
+    return names;
+}
+
+/// Start a process running the command and return its pid.
+static pid_t start_process(std::vector<std::string> const &command)
+{
+    std::vector<char *> argv;
+    for (auto const &arg : command) {
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    pid_t const pid = ::fork();
+    if (pid < 0) {
+        throw std::system_error{errno, std::system_category(),
+                                "Could not start process"};
+    }
+
+    if (pid == 0) {
+        ::execvp(argv[0], argv.data());
+        std::cerr << "Could not run '" << argv[0]
+                  << "': " << std::strerror(errno) << '\n';
+        ::_exit(2);
+    }
+
+    return pid;
+}
+
+bool app(osmium::VerboseOutput &vout, Config const &config,
+         BackfillOptions const &options)
+{
+    auto const start_time = std::chrono::steady_clock::now();
+
+    // The osmdbt-create-diff processes started from here don't use the
+    // usual pid file but one per log file. We take the usual one, so no
+    // other diffs are created and published while we are running.
+    PIDFile pid_file{config.run_dir(), "osmdbt-backfill"};
+    PIDFile create_diff_pid_file{config.run_dir(), "osmdbt-create-diff"};
+
+    auto const logs = find_pending_logs(config);
+    if (logs.empty()) {
+        vout << "No pending log files.\n";
+        vout << "Done.\n";
+        return true;
+    }
+    vout << "Found " << logs.size() << " pending log files.\n";
+
+    // Change files are written by the osmdbt-create-diff processes with the
+    // suffix ".new" in any order, but only published (renamed) in order.
+    std::vector<bool> done(logs.size(), false);
+    std::map<pid_t, std::size_t> running;
+    std::size_t next_start = 0;
+    std::size_t next_publish = 0;
+    std::string error;
+
+    // The osmdbt-create-diff processes don't sync their output files,
+    // all files ready for publishing are synced together here.
+    DurableWriter durable;
+    auto const publish = [&]() {
+        auto const first = next_publish;
+        while (next_publish < logs.size() && done[next_publish]) {
+            auto const file_name = diff_file_name(config, logs[next_publish]);
+            durable.add_file(file_name + ".new", file_name);
+            ++next_publish;
+        }
+        durable.commit();
+        for (auto n = first; n < next_publish; ++n) {
+            vout << "  Published '" << diff_file_name(config, logs[n])
+                 << "'.\n";
+        }
+    };
+
+    vout << "Creating diffs with " << options.jobs() << " jobs...\n";
+    while (next_publish < logs.size()) {
+        while (error.empty() && running.size() < options.jobs() &&
+               next_start < logs.size()) {
+            auto const &log = logs[next_start];
+
+            // left over from an interrupted run
+            std::remove((diff_file_name(config, log) + ".new").c_str());
+
+            std::vector<std::string> command{options.create_diff(),
+                                             "-c",
+                                             options.config_file(),
+                                             "-q",
+                                             "-f",
+                                             log,
+                                             "--no-publish"};
+            command.insert(command.end(),
+                           options.create_diff_options().begin(),
+                           options.create_diff_options().end());
+
+            vout << "  Starting on '" << log << "'...\n";
+            running[start_process(command)] = next_start;
+            ++next_start;
+        }
+
+        if (running.empty()) { // only after an error
+            break;
+        }
+
+        int status = 0;
+        pid_t const pid = ::waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error{errno, std::system_category(),
+                                    "Waiting for process failed"};
+        }
+
+        auto const it = running.find(pid);
+        if (it == running.end()) {
+            continue;
+        }
+        auto const index = it->second;
+        running.erase(it);
+
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            done[index] = true;
+            if (error.empty()) {
+                publish();
+            }
+        } else if (error.empty()) {
+            error = "Creating diff for log file '" + logs[index] + "' failed";
+            std::cerr << error << ". Waiting for other jobs to finish...\n";
+        }
+    }
+
+    // Diffs after a failed one can't be published, remove them so they
+    // are created again on the next run.
+    for (std::size_t n = next_publish; n < logs.size(); ++n) {
+        if (done[n]) {
+            std::remove((diff_file_name(config, logs[n]) + ".new").c_str());
+        }
+    }
+
+    vout << "Published " << next_publish << " of " << logs.size()
+         << " diffs.\n";
+    vout << "Synced " << durable.file_syncs() << " files and "
+         << durable.dir_syncs() << " directories.\n";
+
+    if (!config.metrics_dir().empty()) {
+        std::chrono::duration<double> const duration =
+            std::chrono::steady_clock::now() - start_time;
+
+        Metrics metrics;
+        metrics.gauge("osmdbt_backfill_diffs",
+                      "Number of diffs published in the last run.",
+                      static_cast<double>(next_publish));
+        metrics.gauge("osmdbt_backfill_duration_seconds",
+                      "Duration of the last run.", duration.count());
+        metrics.write(config.metrics_dir(), "osmdbt-backfill");
+        vout << "Wrote metrics.\n";
+    }
+
+    if (!error.empty()) {
+        throw std::runtime_error{error};
+    }
+
+    vout << "Done.\n";
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    BackfillOptions options;
+    return app_wrapper(options, argc, argv);
+}
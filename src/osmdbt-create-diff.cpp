@@ -2,23 +2,44 @@
 #include "config.hpp"
 #include "db.hpp"
 #include "exception.hpp"
+#include "expire.hpp"
 #include "io.hpp"
+#include "metrics.hpp"
 #include "options.hpp"
 #include "osmobj.hpp"
+#include "region.hpp"
+#include "sequence.hpp"
+#include "timings.hpp"
 #include "util.hpp"
 #include "version.hpp"
 
 #include <osmium/io/gzip_compression.hpp>
+#include <osmium/io/reader.hpp>
+#include <osmium/io/xml_input.hpp>
 #include <osmium/io/xml_output.hpp>
 #include <osmium/memory/buffer.hpp>
+#include <osmium/osm/object.hpp>
+#include <osmium/osm/timestamp.hpp>
 #include <osmium/osm/types.hpp>
+#include <osmium/osm/way.hpp>
 #include <osmium/util/memory.hpp>
 #include <osmium/util/string.hpp>
 #include <osmium/util/verbose_output.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <cstdio>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
 #include <string>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 class CreateDiffOptions : public Options
 {
@@ -32,6 +53,38 @@ public:
         return m_log_file_name;
     }
 
+    bool statement_timings() const noexcept { return m_statement_timings; }
+
+    std::size_t buffer_size() const noexcept { return m_buffer_size * 1024; }
+
+    fetch_mode fetch() const noexcept { return m_fetch_mode; }
+
+    bool bulk() const noexcept { return m_bulk; }
+
+    std::size_t checkpoint() const noexcept { return m_checkpoint; }
+
+    bool sequence() const noexcept { return m_sequence; }
+
+    bool augmented() const noexcept { return m_augmented; }
+
+    bool squash() const noexcept { return m_squash; }
+
+    bool publish() const noexcept { return m_publish; }
+
+    bool way_node_locations() const noexcept { return m_way_node_locations; }
+
+    bool regions() const noexcept { return m_regions; }
+
+    std::vector<uint32_t> const &expire_zooms() const noexcept
+    {
+        return m_expire_zooms;
+    }
+
+    std::size_t flush_threshold() const noexcept
+    {
+        return m_flush_threshold * 1024;
+    }
+
 private:
     void add_command_options(po::options_description &desc) override
     {
@@ -39,7 +92,20 @@ private:
 
         // clang-format off
         opts_cmd.add_options()
-            ("log-file,f", po::value<std::string>(), "Log file name (required)");
+            ("log-file,f", po::value<std::string>(), "Log file name (required)")
+            ("fetch", po::value<std::string>(), "How to fetch objects: 'rows' (default), 'arrays', or 'composite'")
+            ("bulk", "Copy object list into temporary table and fetch all objects at once")
+            ("sequence", "Write diff and state files into numbered replication directories")
+            ("augmented", "Also write augmented diff with previous object versions")
+            ("squash", "Only write the last version of each object")
+            ("with-way-node-locations", "Add node locations to way nodes")
+            ("regions", "Also write diffs for the regions in the config file")
+            ("expire-tiles", po::value<std::string>(), "Also write list of expired tiles on these zoom levels (eg '12-14')")
+            ("no-publish", "Leave output file with suffix '.new' to be renamed by caller")
+            ("checkpoint", po::value<std::size_t>(), "Record progress every this many objects so an interrupted run can be resumed")
+            ("statement-timings", "Measure and show latencies of database statements")
+            ("buffer-size", po::value<std::size_t>(), "Size of output buffers in KBytes (default: 1024)")
+            ("flush-threshold", po::value<std::size_t>(), "Write buffer when it is filled to this many KBytes (default: buffer size - 1)");
         // clang-format on
 
         desc.add(opts_cmd);
@@ -54,17 +120,139 @@ private:
             throw argument_error{
                 "Missing '--log-file=FILE' or '-f FILE' on command line"};
         }
+
+        if (vm.count("fetch")) {
+            auto const &mode = vm["fetch"].as<std::string>();
+            if (mode == "rows") {
+                m_fetch_mode = fetch_mode::rows;
+            } else if (mode == "arrays") {
+                m_fetch_mode = fetch_mode::arrays;
+            } else if (mode == "composite") {
+                m_fetch_mode = fetch_mode::composite;
+            } else {
+                throw argument_error{"Unknown fetch mode '" + mode +
+                                     "' (use 'rows', 'arrays', or "
+                                     "'composite')"};
+            }
+        }
+
+        if (vm.count("bulk")) {
+            if (vm.count("fetch")) {
+                throw argument_error{
+                    "Can not use --bulk together with --fetch"};
+            }
+            m_bulk = true;
+        }
+
+        if (vm.count("checkpoint")) {
+            if (m_bulk) {
+                throw argument_error{
+                    "Can not use --checkpoint together with --bulk"};
+            }
+            m_checkpoint = vm["checkpoint"].as<std::size_t>();
+            if (m_checkpoint == 0) {
+                throw argument_error{"Checkpoint interval must be at least 1"};
+            }
+        }
+
+        if (vm.count("sequence")) {
+            m_sequence = true;
+        }
+
+        if (vm.count("augmented")) {
+            if (m_checkpoint) {
+                throw argument_error{
+                    "Can not use --augmented together with --checkpoint"};
+            }
+            m_augmented = true;
+        }
+
+        if (vm.count("squash")) {
+            if (m_augmented) {
+                throw argument_error{
+                    "Can not use --squash together with --augmented"};
+            }
+            m_squash = true;
+        }
+
+        if (vm.count("with-way-node-locations")) {
+            m_way_node_locations = true;
+        }
+
+        if (vm.count("regions")) {
+            if (m_checkpoint) {
+                throw argument_error{
+                    "Can not use --regions together with --checkpoint"};
+            }
+            m_regions = true;
+        }
+
+        if (vm.count("expire-tiles")) {
+            if (m_checkpoint) {
+                throw argument_error{
+                    "Can not use --expire-tiles together with --checkpoint"};
+            }
+            m_expire_zooms =
+                parse_zoom_levels(vm["expire-tiles"].as<std::string>());
+        }
+
+        if (vm.count("no-publish")) {
+            if (m_checkpoint || m_sequence || m_augmented || m_regions ||
+                !m_expire_zooms.empty()) {
+                throw argument_error{
+                    "Can not use --no-publish together with --checkpoint, "
+                    "--sequence, --augmented, --regions, or --expire-tiles"};
+            }
+            m_publish = false;
+        }
+
+        if (vm.count("statement-timings")) {
+            m_statement_timings = true;
+        }
+
+        if (vm.count("buffer-size")) {
+            m_buffer_size = vm["buffer-size"].as<std::size_t>();
+            if (m_buffer_size < 2) {
+                throw argument_error{"Buffer size must be at least 2 KBytes"};
+            }
+        }
+
+        if (vm.count("flush-threshold")) {
+            m_flush_threshold = vm["flush-threshold"].as<std::size_t>();
+            if (m_flush_threshold == 0 || m_flush_threshold > m_buffer_size) {
+                throw argument_error{"Flush threshold must be between 1 and "
+                                     "the buffer size"};
+            }
+        } else {
+            m_flush_threshold = m_buffer_size - 1;
+        }
     }
 
     std::string m_log_file_name;
+    std::size_t m_buffer_size = 1024;
+    std::size_t m_flush_threshold = 0;
+    std::size_t m_checkpoint = 0;
+    bool m_sequence = false;
+    bool m_augmented = false;
+    bool m_squash = false;
+    bool m_publish = true;
+    bool m_way_node_locations = false;
+    bool m_regions = false;
+    std::vector<uint32_t> m_expire_zooms;
+    fetch_mode m_fetch_mode = fetch_mode::rows;
+    bool m_bulk = false;
+    bool m_statement_timings = false;
 }; // class CreateDiffOptions
 
 static void populate_changeset_cache(pqxx::work &txn,
                                      changeset_user_lookup &cucache)
 {
     for (auto &c : cucache) {
-        pqxx::result const result =
-            txn.prepared("changeset_user")(c.first).exec();
+        if (c.second.id != 0) { // already looked up
+            continue;
+        }
+        pqxx::result const result = exec_timed(
+            "changeset_user", txn.prepared("changeset_user")(c.first));
         if (result.size() != 1) {
             throw database_error{
                 "Expected exactly one result (changeset_user)."};
@@ -74,11 +262,361 @@ static void populate_changeset_cache(pqxx::work &txn,
     }
 }
 
+/**
+ * Copy the type, id, and version of all objects into the specified
+ * temporary table which is dropped at the end of the transaction. The
+ * objects must be sorted, duplicates are only copied once. Returns the
+ * number of objects copied.
+ */
+static std::size_t copy_objects_to_temp_table(pqxx::work &txn,
+                                              std::string const &table,
+                                              std::vector<osmobj> const &objects)
+{
+    std::string const statement{"copy_" + table};
+    StatementTimer const timer{statement.c_str()};
+
+    txn.exec("CREATE TEMPORARY TABLE " + table +
+             " (type char(1) NOT NULL, id bigint NOT NULL,"
+             " version bigint NOT NULL) ON COMMIT DROP");
+
+    std::size_t count = 0;
+    pqxx::stream_to stream{txn, table};
+    for (auto it = objects.begin(); it != objects.end(); ++it) {
+        if (it != objects.begin() && !(*std::prev(it) < *it)) {
+            continue;
+        }
+        auto const &obj = *it;
+        ++count;
+        stream << std::make_tuple(
+            std::string(1, osmium::item_type_to_char(obj.type())), obj.id(),
+            static_cast<int64_t>(obj.version()));
+    }
+    stream.complete();
+
+    // Temporary tables are never analyzed automatically, but the planner
+    // needs the statistics to choose merge or hash joins.
+    txn.exec("ANALYZE " + table);
+
+    return count;
+}
+
+/**
+ * Return those objects from the (sorted) list that are deletions, ie. not
+ * visible. The result is sorted.
+ */
+static std::vector<osmobj> deleted_objects(pqxx::work &txn,
+                                           std::vector<osmobj> const &objects)
+{
+    std::vector<osmobj> deleted;
+    if (objects.empty()) {
+        return deleted;
+    }
+
+    copy_objects_to_temp_table(txn, "osmdbt_created", objects);
+
+    std::string query;
+    for (auto const type : {osmium::item_type::node, osmium::item_type::way,
+                            osmium::item_type::relation}) {
+        std::string const name{osmium::item_type_to_name(type)};
+        std::string const type_char(1, osmium::item_type_to_char(type));
+        if (!query.empty()) {
+            query += " UNION ALL ";
+        }
+        query += "SELECT '" + type_char + "', " + name + "_id, version FROM " +
+                 name + "s WHERE (" + name +
+                 "_id, version) IN (SELECT id, version FROM osmdbt_created"
+                 " WHERE type = '" +
+                 type_char + "') AND NOT visible";
+    }
+
+    pqxx::result result;
+    {
+        StatementTimer const timer{"deleted_objects"};
+        result = txn.exec(query);
+    }
+    for (auto const &row : result) {
+        deleted.emplace_back(osmium::char_to_item_type(row[0].c_str()[0]),
+                             row[1].as<osmium::object_id_type>(),
+                             row[2].as<osmium::object_version_type>());
+    }
+    std::sort(deleted.begin(), deleted.end());
+
+    return deleted;
+}
+
+/**
+ * Fetch all objects of the specified type listed in the specified temporary
+ * table ordered by id and version and call the function for each row.
+ * Rows are streamed from the database through a cursor in batches. The
+ * statement timings are recorded as "<type>_<suffix>".
+ */
+template <typename TFunc>
+static void fetch_bulk(pqxx::work &txn, osmium::item_type type,
+                       std::string const &table, char const *suffix,
+                       TFunc &&func)
+{
+    std::string const name{osmium::item_type_to_name(type)};
+    std::string const statement{name + "_" + suffix};
+
+    std::string const condition{
+        "(o." + name + "_id, o.version) IN (SELECT id, version FROM " +
+        table + " WHERE type = '" +
+        osmium::item_type_to_char(type) + "') ORDER BY o." + name +
+        "_id, o.version"};
+
+    pqxx::icursorstream stream{txn,
+                               composite_query(type, condition.c_str()),
+                               "osmdbt_" + statement, 1000};
+
+    pqxx::result rows;
+    while (true) {
+        {
+            StatementTimer const timer{statement.c_str()};
+            stream >> rows;
+        }
+        if (rows.empty()) {
+            break;
+        }
+        for (auto const &row : rows) {
+            func(row);
+        }
+    }
+}
+
+/**
+ * Set the locations of all way nodes in the buffer to the location the
+ * node had when the way version was created, ie. the location of the
+ * newest version of the node not newer than the way. The locations for
+ * all ways in the buffer are fetched with a single query. Nodes that were
+ * deleted at that time don't get a location.
+ */
+static void add_way_node_locations(pqxx::work &txn,
+                                   osmium::memory::Buffer &buffer)
+{
+    // The exact timestamp of the way version is looked up in the database,
+    // the one in the buffer is cut to whole seconds. Nodes created in the
+    // same upload as the way are usually only a fraction of a second older.
+    using node_in_way = std::tuple<osmium::object_id_type,
+                                   osmium::object_id_type,
+                                   osmium::object_version_type>;
+
+    std::vector<node_in_way> keys;
+    for (auto it = buffer.begin<osmium::Way>();
+         it != buffer.end<osmium::Way>(); ++it) {
+        for (auto const &node_ref : it->nodes()) {
+            keys.emplace_back(node_ref.ref(), it->id(), it->version());
+        }
+    }
+
+    if (keys.empty()) {
+        return;
+    }
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    std::string node_ids{"{"};
+    std::string way_ids{"{"};
+    std::string versions{"{"};
+    for (auto const &key : keys) {
+        node_ids += std::to_string(std::get<0>(key));
+        node_ids += ',';
+        way_ids += std::to_string(std::get<1>(key));
+        way_ids += ',';
+        versions += std::to_string(std::get<2>(key));
+        versions += ',';
+    }
+    node_ids.back() = '}';
+    way_ids.back() = '}';
+    versions.back() = '}';
+
+    pqxx::result const result = exec_timed(
+        "way_node_locations",
+        txn.prepared("way_node_locations")(node_ids)(way_ids)(versions));
+
+    // Results are ordered by node id, way id, and version just like the
+    // keys.
+    std::vector<std::pair<node_in_way, osmium::Location>> locations;
+    locations.reserve(result.size());
+    for (auto const &row : result) {
+        if (row[5].c_str()[0] != 't') { // not visible
+            continue;
+        }
+        locations.emplace_back(
+            node_in_way{row[0].as<osmium::object_id_type>(),
+                        row[1].as<osmium::object_id_type>(),
+                        row[2].as<osmium::object_version_type>()},
+            osmium::Location{row[3].as<int64_t>(), row[4].as<int64_t>()});
+    }
+
+    for (auto it = buffer.begin<osmium::Way>();
+         it != buffer.end<osmium::Way>(); ++it) {
+        for (auto &node_ref : it->nodes()) {
+            node_in_way const key{node_ref.ref(), it->id(), it->version()};
+            auto const loc = std::lower_bound(
+                locations.begin(), locations.end(), key,
+                [](std::pair<node_in_way, osmium::Location> const &a,
+                   node_in_way const &b) { return a.first < b; });
+            if (loc != locations.end() && loc->first == key) {
+                node_ref.set_location(loc->second);
+            }
+        }
+    }
+}
+
+/**
+ * Return the previous versions of all objects in the list (which must be
+ * sorted) that are not in the list themselves. The result is sorted, too.
+ */
+static std::vector<osmobj>
+previous_versions(std::vector<osmobj> const &objects)
+{
+    std::vector<osmobj> previous;
+
+    for (auto it = objects.begin(); it != objects.end(); ++it) {
+        if (it->version() <= 1) {
+            continue;
+        }
+        osmobj const prev{it->type(), it->id(), it->version() - 1};
+        if (it != objects.begin() && !(*std::prev(it) < prev)) {
+            continue;
+        }
+        previous.push_back(prev);
+    }
+
+    return previous;
+}
+
+/**
+ * Fetch all objects in the (sorted) list in bulk and build them into the
+ * buffer. The offsets of the objects in the buffer are added to offsets in
+ * the same order as the list. The changesets of the objects are added to
+ * the cache.
+ */
+static void fetch_previous_versions(pqxx::work &txn,
+                                    std::vector<osmobj> const &previous,
+                                    changeset_user_lookup &cucache,
+                                    osmium::memory::Buffer &buffer,
+                                    std::vector<std::size_t> &offsets)
+{
+    copy_objects_to_temp_table(txn, "osmdbt_previous", previous);
+
+    std::string query;
+    for (auto const type : {osmium::item_type::node, osmium::item_type::way,
+                            osmium::item_type::relation}) {
+        std::string const name{osmium::item_type_to_name(type)};
+        if (!query.empty()) {
+            query += " UNION ";
+        }
+        query += "SELECT changeset_id FROM " + name + "s WHERE (" + name +
+                 "_id, version) IN (SELECT id, version FROM osmdbt_previous"
+                 " WHERE type = '" +
+                 osmium::item_type_to_char(type) + "')";
+    }
+
+    pqxx::result const result = txn.exec(query);
+    for (auto const &row : result) {
+        cucache[row[0].as<osmium::changeset_id_type>()];
+    }
+    populate_changeset_cache(txn, cucache);
+
+    for (auto const type : {osmium::item_type::node, osmium::item_type::way,
+                            osmium::item_type::relation}) {
+        fetch_bulk(txn, type, "osmdbt_previous", "previous",
+                   [&](pqxx::row const &row) {
+                       auto const cid = row[2].as<osmium::changeset_id_type>();
+                       offsets.push_back(buffer.committed());
+                       osmobj::build_composite(type, buffer, row,
+                                               cucache.at(cid));
+                   });
+    }
+
+    if (offsets.size() != previous.size()) {
+        throw database_error{"Expected " + std::to_string(previous.size()) +
+                             " previous object versions from database, got " +
+                             std::to_string(offsets.size())};
+    }
+}
+
+/// Output for a region diff (see --regions option).
+struct region_output
+{
+    std::string dir_name;
+    std::string file_name;
+    std::unique_ptr<osmium::io::Writer> writer;
+    osmium::memory::Buffer buffer;
+};
+
+/**
+ * Progress of an interrupted run: The number of segment files completely
+ * written and the number of objects in them.
+ */
+struct checkpoint_type
+{
+    std::size_t segments = 0;
+    std::size_t objects = 0;
+};
+
+/**
+ * Read the checkpoint file if it exists and was written for the specified
+ * log file. Otherwise returns an empty checkpoint.
+ */
+static checkpoint_type read_checkpoint(std::string const &file_name,
+                                       std::string const &log_file_name)
+{
+    checkpoint_type checkpoint;
+
+    std::ifstream file{file_name};
+    if (!file.is_open()) {
+        return checkpoint;
+    }
+
+    std::string log;
+    checkpoint_type data;
+    if (!(file >> log >> data.segments >> data.objects)) {
+        throw std::runtime_error{"Invalid checkpoint file '" + file_name +
+                                 "'"};
+    }
+
+    if (log == log_file_name) {
+        checkpoint = data;
+    }
+
+    return checkpoint;
+}
+
+static void write_checkpoint(std::string const &dir_name,
+                             std::string const &log_file_name,
+                             checkpoint_type const &checkpoint)
+{
+    std::string const data{log_file_name + ' ' +
+                           std::to_string(checkpoint.segments) + ' ' +
+                           std::to_string(checkpoint.objects) + '\n'};
+    write_data_to_file(data, dir_name, "/osmdbt-create-diff.checkpoint");
+}
+
+static std::string segment_file_name(std::string const &osm_data_file_name,
+                                     std::size_t segment)
+{
+    return osm_data_file_name + ".part" + std::to_string(segment);
+}
+
 bool app(osmium::VerboseOutput &vout, Config const &config,
          CreateDiffOptions const &options)
 {
+    auto const start_time = std::chrono::steady_clock::now();
     changeset_user_lookup cucache;
-    PIDFile pid_file{config.run_dir(), "osmdbt-create-diff"};
+    // Without publishing, several processes can work on different log
+    // files at the same time (see osmdbt-backfill).
+    PIDFile pid_file{config.run_dir(),
+                     options.publish()
+                         ? std::string{"osmdbt-create-diff"}
+                         : "osmdbt-create-diff-" +
+                               replace_suffix(options.log_file_name(), "")};
+
+    if (options.statement_timings()) {
+        statement_timings().enable();
+    }
 
     vout << "Connecting to database...\n";
     pqxx::connection db{config.db_connection()};
@@ -87,15 +625,19 @@ bool app(osmium::VerboseOutput &vout, Config const &config,
                "SELECT c.id, c.user_id, u.display_name FROM changesets c, "
                "users u WHERE c.user_id = u.id AND c.id = $1");
 
-    db.prepare(
-        "node",
-        R"(SELECT node_id, version, changeset_id, visible, to_char(timestamp, 'YYYY-MM-DD"T"HH24:MI:SS"Z"') AS timestamp, longitude, latitude FROM nodes WHERE node_id=$1 AND version=$2)");
-    db.prepare(
-        "way",
-        R"(SELECT way_id, version, changeset_id, visible, to_char(timestamp, 'YYYY-MM-DD"T"HH24:MI:SS"Z"') AS timestamp FROM ways WHERE way_id=$1 AND version=$2)");
-    db.prepare(
-        "relation",
-        R"(SELECT relation_id, version, changeset_id, visible, to_char(timestamp, 'YYYY-MM-DD"T"HH24:MI:SS"Z"') AS timestamp FROM relations WHERE relation_id=$1 AND version=$2)");
+    db.prepare("node",
+               "SELECT node_id, version, changeset_id, visible,"
+               " floor(extract(epoch from timestamp))::bigint AS timestamp,"
+               " longitude, latitude FROM nodes"
+               " WHERE node_id=$1 AND version=$2");
+    db.prepare("way",
+               "SELECT way_id, version, changeset_id, visible,"
+               " floor(extract(epoch from timestamp))::bigint AS timestamp"
+               " FROM ways WHERE way_id=$1 AND version=$2");
+    db.prepare("relation",
+               "SELECT relation_id, version, changeset_id, visible,"
+               " floor(extract(epoch from timestamp))::bigint AS timestamp"
+               " FROM relations WHERE relation_id=$1 AND version=$2");
 
     db.prepare("node_tag",
                "SELECT k, v FROM node_tags WHERE node_id=$1 AND version=$2");
@@ -111,60 +653,533 @@ bool app(osmium::VerboseOutput &vout, Config const &config,
         "SELECT member_type, member_id, member_role FROM relation_members "
         "WHERE relation_id=$1 AND version=$2 ORDER BY sequence_id");
 
+    db.prepare("way_nodes_array",
+               "SELECT array_agg(node_id ORDER BY sequence_id) FROM way_nodes "
+               "WHERE way_id=$1 AND version=$2");
+    db.prepare("members_array",
+               "SELECT array_agg(member_type ORDER BY sequence_id),"
+               " array_agg(member_id ORDER BY sequence_id),"
+               " array_agg(member_role ORDER BY sequence_id) "
+               "FROM relation_members WHERE relation_id=$1 AND version=$2");
+
+    db.prepare("way_node_locations",
+               "SELECT w.node_id, w.way_id, w.version, n.longitude,"
+               " n.latitude, n.visible FROM unnest($1::bigint[],"
+               " $2::bigint[], $3::bigint[]) AS w(node_id, way_id, version)"
+               " JOIN ways wv ON wv.way_id = w.way_id"
+               " AND wv.version = w.version"
+               " CROSS JOIN LATERAL (SELECT longitude, latitude, visible"
+               " FROM nodes WHERE node_id = w.node_id"
+               " AND \"timestamp\" <= wv.\"timestamp\""
+               " ORDER BY version DESC LIMIT 1) n"
+               " ORDER BY w.node_id, w.way_id, w.version");
+
+    for (auto const type : {osmium::item_type::node, osmium::item_type::way,
+                            osmium::item_type::relation}) {
+        std::string const name{osmium::item_type_to_name(type)};
+        std::string const condition{"o." + name + "_id=$1 AND o.version=$2"};
+        db.prepare(name + "_composite",
+                   composite_query(type, condition.c_str()));
+    }
+
     pqxx::work txn{db};
     vout << "Database version: " << get_db_version(txn) << '\n';
 
     vout << "Reading log file '" << options.log_file_name() << "'...\n";
-    auto const objects_todo =
+    auto objects_todo =
         read_log(config.log_dir(), options.log_file_name(), &cucache);
     vout << "  Got " << objects_todo.size() << " objects.\n";
 
+    // The previous versions of the objects are needed for the augmented
+    // diff, to expire the tiles at the old locations, and to find the
+    // regions objects were in before.
+    std::vector<osmobj> previous;
+    if (options.augmented() || !options.expire_zooms().empty() ||
+        options.regions()) {
+        previous = previous_versions(objects_todo);
+    }
+
+    if (options.squash()) {
+        vout << "Squashing object versions...\n";
+        auto const created = created_objects(objects_todo);
+        auto squashed =
+            squash_versions(objects_todo, deleted_objects(txn, created));
+        vout << "  Got " << squashed.size() << " objects.\n";
+
+        // The versions squashed away are not in the diff, but their
+        // locations have to be expired and their regions found, too.
+        if (!options.expire_zooms().empty() || options.regions()) {
+            std::set_difference(objects_todo.begin(), objects_todo.end(),
+                                squashed.begin(), squashed.end(),
+                                std::back_inserter(previous));
+            std::sort(previous.begin(), previous.end());
+        }
+        objects_todo = std::move(squashed);
+
+        // only look up the changesets still needed
+        cucache.clear();
+        for (auto const &obj : objects_todo) {
+            cucache[obj.cid()];
+        }
+    }
+
     vout << "Populating changeset cache...\n";
     populate_changeset_cache(txn, cucache);
     vout << "  Got " << cucache.size() << " changesets.\n";
 
-    auto const osm_data_file_name = replace_suffix(
-        config.changes_dir() + "/" + options.log_file_name(), ".osc.gz");
-    vout << "Opening output file '" << osm_data_file_name << ".new'...\n";
-    osmium::io::File file{osm_data_file_name + ".new", "osc.gz"};
+    // In sequence mode the sequence number is only recorded as used after
+    // the diff is written, so a resumed run gets the same one. It is
+    // recorded together with the log file name, so a repeated run on the
+    // log file published last uses its number again instead of publishing
+    // the same changes under a new number.
+    std::uint64_t sequence = 0;
+    if (options.sequence()) {
+        auto const record = read_sequence_record(config.run_dir());
+        if (record.log_file_name == options.log_file_name()) {
+            sequence = record.sequence;
+            vout << "Log file was already published with sequence number "
+                 << sequence << ", using it again.\n";
+        } else {
+            sequence = record.sequence + 1;
+            vout << "Using sequence number " << sequence << ".\n";
+        }
+        create_sequence_dirs(config.changes_dir(), sequence);
+    }
+
+    auto const output_base_name =
+        options.sequence()
+            ? config.changes_dir() + "/" + sequence_path(sequence)
+            : replace_suffix(
+                  config.changes_dir() + "/" + options.log_file_name(), "");
+    auto const osm_data_file_name = output_base_name + ".osc.gz";
+    auto const augmented_file_name = output_base_name + ".osh.gz";
+    auto const tiles_file_name = output_base_name + ".tiles";
 
     osmium::io::Header header;
     header.has_multiple_object_versions();
     header.set("generator",
                std::string{"osmdbt-create-diff/"} + get_osmdbt_version());
 
-    osmium::io::Writer writer{file, header, osmium::io::overwrite::no,
-                              osmium::io::fsync::yes};
+    // Segment files are synced right away, because the checkpoint refers
+    // to them. Other output files are synced together when they are
+    // published.
+    auto const open_writer = [&](std::string const &file_name,
+                                 osmium::io::overwrite allow_overwrite,
+                                 osmium::io::fsync sync) {
+        vout << "Opening output file '" << file_name << "'...\n";
+        osmium::io::File file{file_name, "osc.gz"};
+        if (options.way_node_locations()) {
+            file.set("locations_on_ways");
+        }
+        return std::unique_ptr<osmium::io::Writer>{new osmium::io::Writer{
+            file, header, allow_overwrite, sync}};
+    };
+
+    // In checkpoint mode the output is written into segment files first,
+    // after each segment the progress is recorded in the checkpoint file.
+    std::string const checkpoint_file_name{config.run_dir() +
+                                           "/osmdbt-create-diff.checkpoint"};
+    checkpoint_type checkpoint;
+    std::unique_ptr<osmium::io::Writer> writer;
+    if (options.checkpoint()) {
+        std::remove((checkpoint_file_name + ".new").c_str());
+        checkpoint =
+            read_checkpoint(checkpoint_file_name, options.log_file_name());
+        if (checkpoint.objects > 0) {
+            vout << "Resuming from checkpoint after " << checkpoint.objects
+                 << " objects in " << checkpoint.segments << " segments.\n";
+        }
+        writer = open_writer(
+            segment_file_name(osm_data_file_name, checkpoint.segments),
+            osmium::io::overwrite::allow, osmium::io::fsync::yes);
+    } else {
+        writer = open_writer(osm_data_file_name + ".new",
+                             osmium::io::overwrite::no,
+                             osmium::io::fsync::no);
+    }
+
+    // In augmented mode the previous versions of all objects are written
+    // to a history file, each one right before the new version. Those not
+    // in the log themselves are fetched up front.
+    std::vector<std::size_t> previous_offsets;
+    osmium::memory::Buffer previous_buffer{1024};
+    std::unique_ptr<osmium::io::Writer> augmented_writer;
+    if (!previous.empty()) {
+        vout << "Fetching " << previous.size()
+             << " previous object versions...\n";
+        fetch_previous_versions(txn, previous, cucache, previous_buffer,
+                                previous_offsets);
+    }
+    if (options.augmented()) {
+        vout << "Opening output file '" << augmented_file_name
+             << ".new'...\n";
+        osmium::io::File file{augmented_file_name + ".new", "osh.gz"};
+        if (options.way_node_locations()) {
+            file.set("locations_on_ways");
+        }
+        augmented_writer.reset(new osmium::io::Writer{
+            file, header, osmium::io::overwrite::no, osmium::io::fsync::no});
+    }
+
+    // Objects for the region diffs are copied from the buffers of the main
+    // diff just before they are written.
+    std::unique_ptr<RegionFilter> region_filter;
+    std::vector<region_output> regions;
+    if (options.regions()) {
+        if (config.regions().empty()) {
+            throw config_error{"No regions configured."};
+        }
+        region_filter.reset(new RegionFilter{config.regions()});
+        for (auto const &region : config.regions()) {
+            region_output output;
+            output.dir_name = config.changes_dir() + "/" + region.name;
+            create_dir(output.dir_name);
+            if (options.sequence()) {
+                create_sequence_dirs(output.dir_name, sequence);
+            }
+            output.file_name =
+                output.dir_name +
+                output_base_name.substr(config.changes_dir().size()) +
+                ".osc.gz";
+            output.writer =
+                open_writer(output.file_name + ".new",
+                            osmium::io::overwrite::no, osmium::io::fsync::no);
+            output.buffer = osmium::memory::Buffer{options.buffer_size()};
+            regions.push_back(std::move(output));
+        }
+    }
+
+    // The tiles touched by nodes and way nodes are collected while the
+    // buffers are written, using the way node locations. The tiles of the
+    // previous versions (old locations of moved nodes, old nodes of changed
+    // or deleted ways) are expired, too.
+    std::unique_ptr<TileExpiry> expiry;
+    if (!options.expire_zooms().empty()) {
+        expiry.reset(new TileExpiry{options.expire_zooms()});
+    }
+
+    // Deleted objects and objects leaving a region are put into the
+    // region diffs by the regions of their previous versions.
+    if (expiry || region_filter) {
+        add_way_node_locations(txn, previous_buffer);
+        for (auto it = previous_buffer.cbegin<osmium::OSMObject>();
+             it != previous_buffer.cend<osmium::OSMObject>(); ++it) {
+            if (expiry) {
+                expiry->add_object(*it);
+            }
+            if (region_filter) {
+                region_filter->add_previous_version(*it);
+            }
+        }
+    }
 
     vout << "Processing " << objects_todo.size() << " objects...\n";
-    std::size_t const buffer_size = 1024 * 1024;
+    auto const process_start = std::chrono::steady_clock::now();
+    std::size_t const buffer_size = options.buffer_size();
+    std::size_t const flush_threshold = options.flush_threshold();
     osmium::memory::Buffer buffer{buffer_size};
-    std::size_t count = 0;
-    for (auto const &obj : objects_todo) {
-        obj.get_data(txn, buffer, cucache);
+    std::size_t count = checkpoint.objects;
+    std::size_t buffers_written = 0;
+    std::size_t max_buffer_size = buffer_size;
+    osmium::Timestamp newest_timestamp;
+
+    auto const update_newest_timestamp =
+        [&](osmium::memory::Buffer const &data) {
+            for (auto it = data.cbegin<osmium::OSMObject>();
+                 it != data.cend<osmium::OSMObject>(); ++it) {
+                if (!newest_timestamp.valid() ||
+                    it->timestamp() > newest_timestamp) {
+                    newest_timestamp = it->timestamp();
+                }
+            }
+        };
+
+    std::vector<std::size_t> found_regions;
+    auto const add_to_regions = [&](osmium::memory::Buffer const &data) {
+        for (auto it = data.cbegin<osmium::OSMObject>();
+             it != data.cend<osmium::OSMObject>(); ++it) {
+            region_filter->find_regions(*it, found_regions);
+            for (auto const n : found_regions) {
+                auto &output = regions[n];
+                output.buffer.add_item(*it);
+                output.buffer.commit();
+                if (output.buffer.committed() >= flush_threshold) {
+                    (*output.writer)(std::move(output.buffer));
+                    output.buffer = osmium::memory::Buffer{buffer_size};
+                }
+            }
+        }
+    };
+
+    auto const write_buffer = [&]() {
+        if (buffer.committed() > 0) {
+            max_buffer_size = std::max(max_buffer_size, buffer.capacity());
+            if (options.way_node_locations() || region_filter || expiry) {
+                add_way_node_locations(txn, buffer);
+            }
+            if (region_filter) {
+                add_to_regions(buffer);
+            }
+            if (expiry) {
+                for (auto it = buffer.cbegin<osmium::OSMObject>();
+                     it != buffer.cend<osmium::OSMObject>(); ++it) {
+                    expiry->add_object(*it);
+                }
+            }
+            update_newest_timestamp(buffer);
+            (*writer)(std::move(buffer));
+            ++buffers_written;
+            buffer = osmium::memory::Buffer{buffer_size};
+        }
+    };
+
+    auto const finish_segment = [&]() {
+        write_buffer();
+        writer->close();
+        ++checkpoint.segments;
+        checkpoint.objects = count;
+        write_checkpoint(config.run_dir(), options.log_file_name(),
+                         checkpoint);
+        vout << "  Checkpoint after " << count << " objects.\n";
+    };
+
+    osmium::memory::Buffer augmented_buffer{buffer_size};
+    std::size_t previous_index = 0;
+
+    auto const write_augmented_buffer = [&]() {
+        if (augmented_buffer.committed() > 0) {
+            if (options.way_node_locations()) {
+                add_way_node_locations(txn, augmented_buffer);
+            }
+            (*augmented_writer)(std::move(augmented_buffer));
+            augmented_buffer = osmium::memory::Buffer{buffer_size};
+        }
+    };
+
+    // Add the object at the offset in the buffer to the augmented diff
+    // together with its previous version if that isn't in the log.
+    auto const add_augmented = [&](std::size_t offset) {
+        auto const &object = buffer.get<osmium::OSMObject>(offset);
+        osmobj const prev{object.type(), object.id(), object.version() - 1};
+        while (previous_index < previous.size() &&
+               previous[previous_index] < prev) {
+            ++previous_index;
+        }
+        if (previous_index < previous.size() &&
+            !(prev < previous[previous_index])) {
+            augmented_buffer.add_item(previous_buffer.get<osmium::OSMObject>(
+                previous_offsets[previous_index]));
+            augmented_buffer.commit();
+        }
+        augmented_buffer.add_item(object);
+        augmented_buffer.commit();
+        if (augmented_buffer.committed() >= flush_threshold) {
+            write_augmented_buffer();
+        }
+    };
+
+    auto const object_done = [&](std::size_t offset) {
         ++count;
-        if (buffer.committed() > buffer_size - 1024) {
+        if (augmented_writer) {
+            add_augmented(offset);
+        }
+        if (buffer.committed() >= flush_threshold) {
             vout << "  " << count << " done\n";
-            writer(std::move(buffer));
-            buffer = osmium::memory::Buffer{buffer_size};
+            write_buffer();
+        }
+        if (options.checkpoint() &&
+            count - checkpoint.objects >= options.checkpoint()) {
+            finish_segment();
+            writer = open_writer(
+                segment_file_name(osm_data_file_name, checkpoint.segments),
+                osmium::io::overwrite::allow, osmium::io::fsync::yes);
+        }
+    };
+
+    if (options.bulk()) {
+        vout << "Copying object list into temporary table...\n";
+        auto const num_objects =
+            copy_objects_to_temp_table(txn, "osmdbt_objects", objects_todo);
+        for (auto const type :
+             {osmium::item_type::node, osmium::item_type::way,
+              osmium::item_type::relation}) {
+            vout << "Fetching " << osmium::item_type_to_name(type)
+                 << "s...\n";
+            fetch_bulk(txn, type, "osmdbt_objects", "bulk",
+                       [&](pqxx::row const &row) {
+                auto const cid = row[2].as<osmium::changeset_id_type>();
+                auto const offset = buffer.committed();
+                osmobj::build_composite(type, buffer, row, cucache.at(cid));
+                object_done(offset);
+            });
+        }
+        if (count != num_objects) {
+            throw database_error{"Expected " + std::to_string(num_objects) +
+                                 " objects from database, got " +
+                                 std::to_string(count)};
+        }
+    } else {
+        for (auto it = objects_todo.begin() + checkpoint.objects;
+             it != objects_todo.end(); ++it) {
+            auto const offset = buffer.committed();
+            it->get_data(txn, buffer, cucache, options.fetch());
+            object_done(offset);
         }
     }
 
     if (buffer.committed() > 0) {
-        writer(std::move(buffer));
         vout << "  " << count << " done\n";
     }
 
+    if (options.checkpoint()) {
+        finish_segment();
+
+        auto const file_name = osm_data_file_name + ".new";
+        std::remove(file_name.c_str());
+        writer = open_writer(file_name, osmium::io::overwrite::no,
+                             osmium::io::fsync::no);
+        vout << "Merging " << checkpoint.segments << " segments...\n";
+        for (std::size_t n = 0; n < checkpoint.segments; ++n) {
+            osmium::io::Reader reader{
+                osmium::io::File{segment_file_name(osm_data_file_name, n),
+                                 "osc.gz"}};
+            while (osmium::memory::Buffer segment_buffer = reader.read()) {
+                update_newest_timestamp(segment_buffer);
+                (*writer)(std::move(segment_buffer));
+            }
+            reader.close();
+        }
+    } else {
+        write_buffer();
+    }
+
+    std::chrono::duration<double> const process_duration =
+        std::chrono::steady_clock::now() - process_start;
+    vout << "Processed " << count << " objects in " << process_duration.count()
+         << " seconds (" << (count / process_duration.count())
+         << " objects/s).\n";
+    vout << "Wrote " << buffers_written << " buffers of "
+         << (buffer_size / 1024) << " KBytes";
+    if (max_buffer_size > buffer_size) {
+        vout << " (a buffer had to grow to " << (max_buffer_size / 1024)
+             << " KBytes, consider a larger buffer size or smaller flush "
+                "threshold)";
+    }
+    vout << ".\n";
+
     txn.commit();
-    writer.close();
+    writer->close();
+
+    // All output files are synced together and published in one go. The
+    // state files are published afterwards, so they never refer to a diff
+    // which isn't durable yet.
+    DurableWriter durable;
+    if (options.publish()) {
+        durable.add_file(osm_data_file_name + ".new", osm_data_file_name);
+    }
+
+    if (augmented_writer) {
+        write_augmented_buffer();
+        augmented_writer->close();
+        durable.add_file(augmented_file_name + ".new", augmented_file_name);
+    }
+
+    if (expiry) {
+        durable.add_data(tiles_file_name, expiry->list());
+    }
 
-    rename_file(osm_data_file_name + ".new", osm_data_file_name);
-    sync_dir(dirname(osm_data_file_name));
-    vout << "Wrote and synced output file.\n";
+    if (!newest_timestamp.valid()) {
+        newest_timestamp = osmium::Timestamp{std::time(nullptr)};
+    }
+
+    for (auto &output : regions) {
+        if (output.buffer.committed() > 0) {
+            (*output.writer)(std::move(output.buffer));
+        }
+        output.writer->close();
+        durable.add_file(output.file_name + ".new", output.file_name);
+    }
+
+    durable.commit();
+    if (options.publish()) {
+        vout << "Wrote and synced output file.\n";
+    } else {
+        vout << "Wrote output file '" << osm_data_file_name
+             << ".new' (not synced).\n";
+    }
+    if (augmented_writer) {
+        vout << "Wrote and synced augmented diff.\n";
+    }
+    if (expiry) {
+        vout << "Wrote and synced list of expired tiles.\n";
+    }
+    if (!regions.empty()) {
+        vout << "Wrote and synced " << regions.size() << " region diffs.\n";
+    }
+
+    if (options.sequence()) {
+        auto const state = state_file_content(sequence, newest_timestamp);
+        auto const state_file_name =
+            "/" + sequence_path(sequence) + ".state.txt";
+        for (auto const &output : regions) {
+            durable.add_data(output.dir_name + state_file_name, state);
+        }
+        durable.add_data(config.changes_dir() + state_file_name, state);
+        durable.commit();
+
+        write_sequence(config.run_dir(), sequence, options.log_file_name());
+
+        for (auto const &output : regions) {
+            durable.add_data(output.dir_name + "/state.txt", state);
+        }
+        durable.add_data(config.changes_dir() + "/state.txt", state);
+        durable.commit();
+        vout << "Wrote and synced state files for sequence " << sequence
+             << ".\n";
+    }
+
+    vout << "Synced " << durable.file_syncs() << " files and "
+         << durable.dir_syncs() << " directories.\n";
+
+    if (options.checkpoint()) {
+        for (std::size_t n = 0; n < checkpoint.segments; ++n) {
+            std::remove(segment_file_name(osm_data_file_name, n).c_str());
+        }
+        std::remove(checkpoint_file_name.c_str());
+        vout << "Removed segment files and checkpoint.\n";
+    }
 
     vout << "All done.\n";
     txn.commit();
 
+    if (options.statement_timings()) {
+        statement_timings().print(vout);
+    }
+
+    if (!config.metrics_dir().empty()) {
+        std::chrono::duration<double> const duration =
+            std::chrono::steady_clock::now() - start_time;
+
+        Metrics metrics;
+        metrics.gauge("osmdbt_create_diff_objects",
+                      "Number of objects written in the last run.",
+                      static_cast<double>(count));
+        metrics.gauge("osmdbt_create_diff_duration_seconds",
+                      "Duration of the last run.", duration.count());
+        metrics.gauge("osmdbt_create_diff_file_syncs",
+                      "Number of files synced in the last run.",
+                      static_cast<double>(durable.file_syncs()));
+        metrics.gauge("osmdbt_create_diff_dir_syncs",
+                      "Number of directories synced in the last run.",
+                      static_cast<double>(durable.dir_syncs()));
+        metrics.gauge("osmdbt_create_diff_last_run_timestamp_seconds",
+                      "Time of the last successful run.",
+                      static_cast<double>(std::time(nullptr)));
+        statement_timings().add_metrics(metrics);
+        metrics.write(config.metrics_dir(), "osmdbt-create-diff");
+        vout << "Wrote metrics.\n";
+    }
+
     osmium::MemoryUsage mem;
     vout << "Current memory used: " << mem.current() << " MBytes\n";
     vout << "Peak memory used: " << mem.peak() << " MBytes\n";
@@ -0,0 +1,564 @@
+
+#include "config.hpp"
+#include "db.hpp"
+#include "exception.hpp"
+#include "io.hpp"
+#include "metrics.hpp"
+#include "options.hpp"
+#include "osmobj.hpp"
+#include "sequence.hpp"
+#include "util.hpp"
+#include "version.hpp"
+
+#include <osmium/io/gzip_compression.hpp>
+#include <osmium/io/opl_output.hpp>
+#include <osmium/io/pbf_output.hpp>
+#include <osmium/io/writer.hpp>
+#include <osmium/io/xml_output.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/timestamp.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/util/memory.hpp>
+#include <osmium/util/verbose_output.hpp>
+
+#include <unistd.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+class DumpOptions : public Options
+{
+public:
+    DumpOptions()
+    : Options("dump", "Dump full history or current data of the database.")
+    {}
+
+    std::string const &output() const noexcept { return m_output; }
+
+    std::size_t jobs() const noexcept { return m_jobs; }
+
+    std::size_t partitions() const noexcept { return m_partitions; }
+
+    std::size_t shards() const noexcept { return m_shards; }
+
+    bool create_slot() const noexcept { return m_create_slot; }
+
+    bool current() const noexcept { return m_current; }
+
+private:
+    void add_command_options(po::options_description &desc) override
+    {
+        po::options_description opts_cmd{"COMMAND OPTIONS"};
+
+        // clang-format off
+        opts_cmd.add_options()
+            ("output,o", po::value<std::string>(), "Output file name (required)")
+            ("jobs,j", po::value<std::size_t>(), "Number of parallel database connections (default: 4)")
+            ("partitions,p", po::value<std::size_t>(), "Number of id range partitions per object type (default: 16)")
+            ("shards,s", po::value<std::size_t>(), "Number of output files (default: 1)")
+            ("current", "Dump only current data from the current_* tables")
+            ("create-slot", "Create the replication slot from the config file at the snapshot of the dump");
+        // clang-format on
+
+        desc.add(opts_cmd);
+    }
+
+    void check_command_options(
+        boost::program_options::variables_map const &vm) override
+    {
+        if (vm.count("output")) {
+            m_output = vm["output"].as<std::string>();
+        } else {
+            throw argument_error{
+                "Missing '--output=FILE' or '-o FILE' on command line"};
+        }
+
+        if (vm.count("jobs")) {
+            m_jobs = vm["jobs"].as<std::size_t>();
+            if (m_jobs == 0) {
+                throw argument_error{"Number of jobs must be at least 1"};
+            }
+        }
+
+        if (vm.count("partitions")) {
+            m_partitions = vm["partitions"].as<std::size_t>();
+            if (m_partitions == 0) {
+                throw argument_error{
+                    "Number of partitions must be at least 1"};
+            }
+        }
+
+        if (vm.count("shards")) {
+            m_shards = vm["shards"].as<std::size_t>();
+            if (m_shards == 0 || m_shards > m_partitions * 3) {
+                throw argument_error{"Number of shards must be between 1 and "
+                                     "three times the number of partitions"};
+            }
+        }
+
+        if (vm.count("current")) {
+            m_current = true;
+        }
+
+        if (vm.count("create-slot")) {
+            m_create_slot = true;
+        }
+    }
+
+    std::string m_output;
+    std::size_t m_jobs = 4;
+    std::size_t m_partitions = 16;
+    std::size_t m_shards = 1;
+    bool m_create_slot = false;
+    bool m_current = false;
+}; // class DumpOptions
+
+/// A range of ids of one object type dumped in one go.
+struct partition
+{
+    osmium::item_type type;
+    osmium::object_id_type from; // inclusive
+    osmium::object_id_type to;   // exclusive
+};
+
+/// Some statistics about a partition.
+struct partition_result
+{
+    std::size_t count = 0;
+    osmium::Timestamp newest_timestamp;
+};
+
+/**
+ * Bounded queue of the buffers of one partition passed from the job
+ * reading the partition to the output writer. The job waits while the
+ * queue is full, so only a few buffers per job are kept in memory even if
+ * the writer is still busy with earlier partitions.
+ */
+class buffer_queue
+{
+public:
+    static constexpr std::size_t const max_size = 10;
+
+    /// Add a buffer, wait while the queue is full.
+    void push(osmium::memory::Buffer &&buffer)
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_space.wait(lock, [this]() {
+            return m_cancelled || m_buffers.size() < max_size;
+        });
+        if (m_cancelled) {
+            throw std::runtime_error{"Dump cancelled"};
+        }
+        m_buffers.push_back(std::move(buffer));
+        m_data.notify_one();
+    }
+
+    /// Mark the end of the partition. No more buffers are added.
+    void finish()
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_finished = true;
+        m_data.notify_one();
+    }
+
+    /// Stop the job adding buffers, called if the writer fails.
+    void cancel()
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_cancelled = true;
+        m_space.notify_one();
+    }
+
+    /**
+     * Get the next buffer, wait if there is none. Returns false at the end
+     * of the partition.
+     */
+    bool pop(osmium::memory::Buffer &buffer)
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_data.wait(lock,
+                    [this]() { return m_finished || !m_buffers.empty(); });
+        if (m_buffers.empty()) {
+            return false;
+        }
+        buffer = std::move(m_buffers.front());
+        m_buffers.pop_front();
+        m_space.notify_one();
+        return true;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_data;
+    std::condition_variable m_space;
+    std::deque<osmium::memory::Buffer> m_buffers;
+    bool m_finished = false;
+    bool m_cancelled = false;
+}; // class buffer_queue
+
+/**
+ * A partition being read by a job. If it is destroyed before it was
+ * written completely (because of an error), the job is cancelled and
+ * waited for.
+ */
+struct pending_partition
+{
+    buffer_queue queue;
+    std::future<partition_result> result;
+
+    pending_partition() = default;
+    pending_partition(pending_partition const &) = delete;
+    pending_partition &operator=(pending_partition const &) = delete;
+
+    ~pending_partition() { queue.cancel(); }
+};
+
+/**
+ * Split the ids from 1 to max_id (inclusive) into the specified number of
+ * partitions of (about) the same size.
+ */
+static void add_partitions(std::vector<partition> &partitions,
+                           osmium::item_type type,
+                           osmium::object_id_type max_id, std::size_t count)
+{
+    osmium::object_id_type const step =
+        max_id / static_cast<osmium::object_id_type>(count) + 1;
+
+    osmium::object_id_type from = 1;
+    for (std::size_t n = 0; n < count; ++n) {
+        partitions.push_back(partition{type, from, from + step});
+        from += step;
+    }
+}
+
+/**
+ * Return the suffix of the file name including the format and compression,
+ * for instance "osh.pbf" for "dir/planet.osh.pbf".
+ */
+static std::string file_suffix(std::string const &file_name)
+{
+    auto pos = file_name.find_last_of('/');
+    pos = file_name.find('.', pos == std::string::npos ? 0 : pos);
+    if (pos == std::string::npos) {
+        throw argument_error{"Can not detect format of output file '" +
+                             file_name + "'"};
+    }
+    return file_name.substr(pos + 1);
+}
+
+/**
+ * Return the name of the output file for the specified shard, for instance
+ * "planet-002.osh.pbf" for shard 2 of "planet.osh.pbf".
+ */
+static std::string shard_file_name(std::string const &file_name,
+                                   std::size_t shard)
+{
+    auto const suffix = file_suffix(file_name);
+    std::string number = std::to_string(shard);
+    while (number.size() < 3) {
+        number.insert(0, 1, '0');
+    }
+    return file_name.substr(0, file_name.size() - suffix.size() - 1) + "-" +
+           number + "." + suffix;
+}
+
+/**
+ * Read all objects in the partition from the database and build them into
+ * buffers which are added to the queue. This opens its own connection and
+ * imports the specified snapshot so several partitions can be read in
+ * parallel while still seeing the same database state. Results are
+ * streamed through a cursor. If current is set, only the visible objects
+ * from the current_* tables are read, otherwise all versions from the
+ * history tables.
+ */
+static partition_result read_partition(std::string const &db_connection,
+                                       std::string const &snapshot,
+                                       partition const &part, bool current,
+                                       buffer_queue &queue)
+{
+    constexpr std::size_t const buffer_size = 1024UL * 1024UL;
+
+    pqxx::connection db{db_connection};
+    db.prepare("changeset_users",
+               "SELECT c.id, c.user_id, u.display_name FROM changesets c, "
+               "users u WHERE c.user_id = u.id AND c.id = ANY($1::bigint[])");
+
+    pqxx::transaction<pqxx::repeatable_read> txn{db};
+    txn.exec("SET TRANSACTION SNAPSHOT " + txn.quote(snapshot));
+
+    std::string const name{osmium::item_type_to_name(part.type)};
+    std::string const id_column{current ? "o.id" : "o." + name + "_id"};
+    std::string const condition{
+        (current ? "o.visible AND " : "") + id_column +
+        " >= " + std::to_string(part.from) + " AND " + id_column + " < " +
+        std::to_string(part.to) + " ORDER BY " + id_column + ", o.version"};
+
+    pqxx::icursorstream stream{
+        txn,
+        current ? current_query(part.type, condition.c_str())
+                : composite_query(part.type, condition.c_str()),
+        "osmdbt_dump", 10000};
+
+    partition_result result;
+    osmium::memory::Buffer buffer{buffer_size};
+    changeset_user_lookup cucache;
+
+    pqxx::result rows;
+    while (stream >> rows, !rows.empty()) {
+        lookup_changeset_users(txn, rows, cucache);
+        for (auto const &row : rows) {
+            auto const cid = row[2].as<osmium::changeset_id_type>();
+            auto const &user = cucache.at(cid);
+            if (user.id == 0) {
+                throw database_error{"Unknown user for changeset " +
+                                     std::to_string(cid)};
+            }
+
+            osmium::Timestamp const timestamp{row[4].as<uint32_t>()};
+            if (!result.newest_timestamp.valid() ||
+                timestamp > result.newest_timestamp) {
+                result.newest_timestamp = timestamp;
+            }
+
+            osmobj::build_composite(part.type, buffer, row, user);
+            ++result.count;
+            if (buffer.committed() > buffer_size / 10 * 9) {
+                queue.push(std::move(buffer));
+                buffer = osmium::memory::Buffer{buffer_size};
+            }
+        }
+
+        // changesets are mostly clustered by id, so we don't need to keep
+        // all of them
+        if (cucache.size() > 1000000) {
+            cucache.clear();
+        }
+    }
+
+    txn.commit();
+
+    if (buffer.committed() > 0) {
+        queue.push(std::move(buffer));
+    }
+
+    return result;
+}
+
+/// Read a partition and mark the end in the queue, also on errors.
+static partition_result dump_partition(std::string const &db_connection,
+                                       std::string const &snapshot,
+                                       partition const &part, bool current,
+                                       buffer_queue &queue)
+{
+    try {
+        auto result =
+            read_partition(db_connection, snapshot, part, current, queue);
+        queue.finish();
+        return result;
+    } catch (...) {
+        queue.finish();
+        throw;
+    }
+}
+
+bool app(osmium::VerboseOutput &vout, Config const &config,
+         DumpOptions const &options)
+{
+    auto const start_time = std::chrono::steady_clock::now();
+    PIDFile pid_file{config.run_dir(), "osmdbt-dump"};
+
+    // Creating a replication slot on a replication connection exports a
+    // snapshot which exactly matches the position of the slot. It stays
+    // valid as long as this connection isn't used for anything else. If
+    // the slot from the config isn't created, a temporary slot is used
+    // which is removed automatically at the end.
+    vout << "Connecting to database for replication...\n";
+    pqxx::connection repl{config.db_connection() + " replication=database"};
+    std::string const slot =
+        options.create_slot()
+            ? config.replication_slot()
+            : "osmdbt_dump_" + std::to_string(::getpid());
+
+    vout << "Creating " << (options.create_slot() ? "" : "temporary ")
+         << "replication slot '" << slot << "'...\n";
+    pqxx::nontransaction repl_txn{repl};
+    pqxx::row const slot_info = repl_txn.exec1(
+        "CREATE_REPLICATION_SLOT " + slot +
+        (options.create_slot() ? "" : " TEMPORARY") +
+        " LOGICAL \"osm-logical\" EXPORT_SNAPSHOT");
+    std::string const lsn = slot_info[1].c_str();
+    std::string const snapshot = slot_info[2].c_str();
+    vout << "  Got snapshot '" << snapshot << "' at LSN " << lsn << ".\n";
+
+    vout << "Connecting to database...\n";
+    pqxx::connection db{config.db_connection()};
+    pqxx::transaction<pqxx::repeatable_read> txn{db};
+    txn.exec("SET TRANSACTION SNAPSHOT " + txn.quote(snapshot));
+    vout << "Database version: " << get_db_version(txn) << '\n';
+
+    std::vector<partition> partitions;
+    for (auto const type : {osmium::item_type::node, osmium::item_type::way,
+                            osmium::item_type::relation}) {
+        std::string const name{osmium::item_type_to_name(type)};
+        auto const max_id =
+            txn.exec1(options.current()
+                          ? "SELECT coalesce(max(id), 0) FROM current_" +
+                                name + "s"
+                          : "SELECT coalesce(max(" + name + "_id), 0) FROM " +
+                                name + "s")[0]
+                .as<osmium::object_id_type>();
+        vout << "Largest " << name << " id: " << max_id << '\n';
+        add_partitions(partitions, type, max_id, options.partitions());
+    }
+    txn.commit();
+
+    osmium::io::Header header;
+    header.set_has_multiple_object_versions(!options.current());
+    header.set("generator",
+               std::string{"osmdbt-dump/"} + get_osmdbt_version());
+
+    auto const suffix = file_suffix(options.output());
+    std::vector<std::string> file_names;
+    std::vector<std::unique_ptr<osmium::io::Writer>> writers;
+    for (std::size_t n = 0; n < options.shards(); ++n) {
+        file_names.push_back(options.shards() == 1
+                                 ? options.output()
+                                 : shard_file_name(options.output(), n));
+        vout << "Opening output file '" << file_names.back() << "'...\n";
+        writers.emplace_back(new osmium::io::Writer{
+            osmium::io::File{file_names.back() + ".new", suffix}, header,
+            osmium::io::overwrite::no, osmium::io::fsync::no});
+    }
+
+    // Partitions are read in parallel, but written in order, so the
+    // output is sorted. Each job passes its buffers to the writer through
+    // a bounded queue and waits while the queue is full, so only a few
+    // buffers per job are kept in memory.
+    vout << "Dumping " << partitions.size() << " partitions with "
+         << options.jobs() << " jobs...\n";
+    std::size_t count = 0;
+    osmium::Timestamp newest_timestamp;
+    std::deque<std::unique_ptr<pending_partition>> pending;
+    std::size_t written = 0;
+
+    auto const write_partition = [&]() {
+        auto &front = *pending.front();
+        auto const shard = written * options.shards() / partitions.size();
+        osmium::memory::Buffer buffer;
+        while (front.queue.pop(buffer)) {
+            (*writers[shard])(std::move(buffer));
+        }
+
+        auto const result = front.result.get();
+        pending.pop_front();
+
+        count += result.count;
+        if (result.newest_timestamp.valid() &&
+            (!newest_timestamp.valid() ||
+             result.newest_timestamp > newest_timestamp)) {
+            newest_timestamp = result.newest_timestamp;
+        }
+
+        auto const &part = partitions[written];
+        vout << "  " << osmium::item_type_to_name(part.type) << "s "
+             << part.from << " to " << (part.to - 1) << ": " << result.count
+             << " objects\n";
+        ++written;
+    };
+
+    for (auto const &part : partitions) {
+        if (pending.size() >= options.jobs()) {
+            write_partition();
+        }
+        pending.emplace_back(new pending_partition{});
+        auto &queue = pending.back()->queue;
+        pending.back()->result = std::async(
+            std::launch::async, dump_partition,
+            std::cref(config.db_connection()), std::cref(snapshot),
+            std::cref(part), options.current(), std::ref(queue));
+    }
+    while (!pending.empty()) {
+        write_partition();
+    }
+
+    // Closing the replication connection releases the snapshot and
+    // removes the temporary slot.
+    repl_txn.commit();
+    repl.disconnect();
+
+    DurableWriter durable;
+    for (std::size_t n = 0; n < writers.size(); ++n) {
+        writers[n]->close();
+        durable.add_file(file_names[n] + ".new", file_names[n]);
+    }
+    durable.commit();
+    vout << "Wrote and synced " << count << " objects into "
+         << writers.size() << " output file(s).\n";
+
+    if (!newest_timestamp.valid()) {
+        newest_timestamp = osmium::Timestamp{std::time(nullptr)};
+    }
+
+    // The state file is in the usual format with the position of the
+    // replication slot added. Only if the slot from the config was created
+    // here, the diffs created from it follow the dump directly and the
+    // last sequence number used by osmdbt-create-diff belongs to the dump.
+    // The position of a temporary slot doesn't match any diff, so there is
+    // no sequence number in this case.
+    auto const state_file_name =
+        options.output().substr(0, options.output().size() - suffix.size() -
+                                       1) +
+        ".state.txt";
+    auto state =
+        state_file_content(read_sequence(config.run_dir()), newest_timestamp);
+    if (!options.create_slot()) {
+        state.erase(0, state.find('\n') + 1);
+    }
+    state += "lsn=" + lsn + '\n';
+    durable.add_data(state_file_name, state);
+    durable.commit();
+    vout << "Wrote and synced state file '" << state_file_name << "'.\n";
+
+    if (!config.metrics_dir().empty()) {
+        std::chrono::duration<double> const duration =
+            std::chrono::steady_clock::now() - start_time;
+
+        Metrics metrics;
+        metrics.gauge("osmdbt_dump_objects",
+                      "Number of objects written in the last run.",
+                      static_cast<double>(count));
+        metrics.gauge("osmdbt_dump_duration_seconds",
+                      "Duration of the last run.", duration.count());
+        metrics.gauge("osmdbt_dump_last_run_timestamp_seconds",
+                      "Time of the last successful run.",
+                      static_cast<double>(std::time(nullptr)));
+        metrics.write(config.metrics_dir(), "osmdbt-dump");
+        vout << "Wrote metrics.\n";
+    }
+
+    osmium::MemoryUsage mem;
+    vout << "Current memory used: " << mem.current() << " MBytes\n";
+    vout << "Peak memory used: " << mem.peak() << " MBytes\n";
+
+    vout << "Done.\n";
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    DumpOptions options;
+    return app_wrapper(options, argc, argv);
+}
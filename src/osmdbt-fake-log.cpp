@@ -2,9 +2,11 @@
 #include "config.hpp"
 #include "db.hpp"
 #include "exception.hpp"
+#include "filter.hpp"
 #include "io.hpp"
 #include "options.hpp"
 #include "osmobj.hpp"
+#include "timewindow.hpp"
 #include "util.hpp"
 
 #include <osmium/index/nwr_array.hpp>
@@ -13,15 +15,16 @@
 #include <osmium/util/verbose_output.hpp>
 
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <ctime>
+#include <functional>
+#include <future>
 #include <iostream>
 #include <iterator>
-#include <set>
 #include <string>
 #include <utility>
-
-using id_version_type =
-    std::pair<osmium::object_id_type, osmium::object_version_type>;
+#include <vector>
 
 class FakeLogOptions : public Options
 {
@@ -37,6 +40,12 @@ public:
 
     osmium::Timestamp timestamp() const noexcept { return m_timestamp; }
 
+    osmium::Timestamp until() const noexcept { return m_until; }
+
+    std::time_t interval() const noexcept { return m_interval; }
+
+    bool by_changeset() const noexcept { return m_by_changeset; }
+
 private:
     void add_command_options(po::options_description &desc) override
     {
@@ -45,6 +54,9 @@ private:
         // clang-format off
         opts_cmd.add_options()
             ("timestamp,t", po::value<std::string>(), "Changes at or after this timestamp will be in the log")
+            ("until,u", po::value<std::string>(), "Changes before this timestamp will be in the log (default: no limit)")
+            ("interval,i", po::value<unsigned int>(), "Write one log file per this many seconds")
+            ("by-changeset", "Find changes through the changesets they belong to")
             ("log,l", po::value<std::vector<std::string>>(), "Remove entries found in this log file");
         // clang-format on
 
@@ -61,6 +73,25 @@ private:
                                  "TIMESTAMP' on command line"};
         }
 
+        if (vm.count("until")) {
+            m_until = osmium::Timestamp{vm["until"].as<std::string>()};
+            if (m_until <= m_timestamp) {
+                throw argument_error{
+                    "Timestamp set with --until must be after --timestamp"};
+            }
+        }
+
+        if (vm.count("interval")) {
+            m_interval = vm["interval"].as<unsigned int>();
+            if (m_interval == 0) {
+                throw argument_error{"Interval must be at least one second"};
+            }
+        }
+
+        if (vm.count("by-changeset")) {
+            m_by_changeset = true;
+        }
+
         if (vm.count("log")) {
             m_log_file_names = vm["log"].as<std::vector<std::string>>();
         }
@@ -68,59 +99,161 @@ private:
 
     std::vector<std::string> m_log_file_names;
     osmium::Timestamp m_timestamp{};
+    osmium::Timestamp m_until{};
+    std::time_t m_interval = 0;
+    bool m_by_changeset = false;
 
 }; // class FakeLogOptions
 
-static std::size_t
-read_objects(pqxx::work &txn, std::string &data, osmium::Timestamp timestamp,
-             osmium::item_type type,
-             osmium::nwr_array<std::set<id_version_type>> const &objects_done)
+/**
+ * Build the query for all objects of the specified type changed in the
+ * time window. If by_changeset is set, the objects are found through the
+ * changesets open during that time which can use the indexes on the
+ * changeset_id columns instead of the ones on the timestamp columns.
+ */
+static std::string build_query(pqxx::transaction_base &txn,
+                               osmium::item_type type,
+                               time_window const &window, bool by_changeset)
+{
+    std::string const name{osmium::item_type_to_name(type)};
+
+    std::string query{"SELECT " + name + "_id, version, changeset_id FROM " +
+                      name + "s WHERE \"timestamp\" >= " +
+                      txn.quote(window.start.to_iso())};
+    if (window.end.valid()) {
+        query += " AND \"timestamp\" < " + txn.quote(window.end.to_iso());
+    }
+
+    if (by_changeset) {
+        // All changes in the time window must be in changesets closed
+        // after its start and created before its end.
+        query += " AND changeset_id IN (SELECT id FROM changesets WHERE"
+                 " closed_at >= " +
+                 txn.quote(window.start.to_iso());
+        if (window.end.valid()) {
+            query += " AND created_at < " + txn.quote(window.end.to_iso());
+        }
+        query += ')';
+    }
+
+    query += " ORDER BY " + name + "_id, version";
+
+    return query;
+}
+
+/**
+ * Check with EXPLAIN whether the query for the specified type would need a
+ * sequential scan of the whole history table. If so, print a warning
+ * recommending a suitable index.
+ */
+static void check_query_plan(pqxx::transaction_base &txn,
+                             osmium::item_type type,
+                             time_window const &window, bool by_changeset)
 {
+    std::string const table{osmium::item_type_to_name(type) +
+                            std::string{"s"}};
+
     pqxx::result const result =
-        txn.prepared(osmium::item_type_to_name(type))(timestamp.to_iso())
-            .exec();
+        txn.exec("EXPLAIN " + build_query(txn, type, window, by_changeset));
 
-    if (result.empty()) {
-        return 0;
+    std::string const seq_scan{"Seq Scan on " + table + " "};
+    for (auto const &row : result) {
+        if (std::strstr(row[0].c_str(), seq_scan.c_str())) {
+            std::cerr << "Warning: Query for " << table
+                      << " needs a sequential scan of the whole table.\n";
+            if (by_changeset) {
+                std::cerr << "  Consider adding an index: CREATE INDEX ON "
+                          << table << " (changeset_id);\n";
+            } else {
+                std::cerr << "  Consider adding an index: CREATE INDEX ON "
+                          << table
+                          << " (\"timestamp\"); or use --by-changeset.\n";
+            }
+            return;
+        }
     }
+}
+
+/**
+ * Read all objects of the specified type changed in the specified time
+ * windows from the database and add log lines for those not in
+ * objects_done to the data for the window. This opens its own connection
+ * and imports the specified snapshot so it can run in parallel to the
+ * other types while still seeing the same database state. Results are
+ * streamed through a cursor instead of reading them into memory all at
+ * once.
+ */
+static std::size_t
+read_objects(std::string const &db_connection, std::string const &snapshot,
+             std::vector<time_window> const &windows,
+             std::vector<std::string> &data, osmium::item_type type,
+             bool by_changeset,
+             std::vector<id_version_type> const &objects_done)
+{
+    std::string const name{osmium::item_type_to_name(type)};
 
-    // log lines should fit in 50 bytes
-    data.reserve(data.size() + result.size() * 50);
+    pqxx::connection db{db_connection};
+    pqxx::transaction<pqxx::repeatable_read> txn{db};
+    txn.exec("SET TRANSACTION SNAPSHOT " + txn.quote(snapshot));
 
     std::size_t count = 0;
-    for (auto const &row : result) {
-        auto const p = std::make_pair(row[0].as<osmium::object_id_type>(),
-                                      row[1].as<osmium::object_version_type>());
-        if (!objects_done(type).count(p)) {
-            data += "0/0 0 N ";
-            data += osmium::item_type_to_char(type);
-            data += row[0].c_str();
-            data += " v";
-            data += row[1].c_str();
-            data += " c";
-            data += row[2].c_str();
-            data += '\n';
-            ++count;
+    data.resize(windows.size());
+    for (std::size_t n = 0; n < windows.size(); ++n) {
+        pqxx::icursorstream stream{
+            txn, build_query(txn, type, windows[n], by_changeset),
+            "osmdbt_" + name + "s", 10000};
+
+        // The query results are ordered by id and version just like the
+        // objects_done list, so we can use an IdFilter.
+        IdFilter filter{objects_done};
+
+        pqxx::result result;
+        while (stream >> result, !result.empty()) {
+            // log lines should fit in 50 bytes
+            data[n].reserve(data[n].size() + result.size() * 50);
+
+            for (auto const &row : result) {
+                auto const p =
+                    std::make_pair(row[0].as<osmium::object_id_type>(),
+                                   row[1].as<osmium::object_version_type>());
+                if (!filter.contains(p)) {
+                    data[n] += "0/0 0 N ";
+                    data[n] += osmium::item_type_to_char(type);
+                    data[n] += row[0].c_str();
+                    data[n] += " v";
+                    data[n] += row[1].c_str();
+                    data[n] += " c";
+                    data[n] += row[2].c_str();
+                    data[n] += '\n';
+                    ++count;
+                }
+            }
         }
     }
 
+    txn.commit();
+
     return count;
 }
 
-static osmium::nwr_array<std::set<id_version_type>>
+static osmium::nwr_array<std::vector<id_version_type>>
 read_log_files(std::string const &log_dir,
                std::vector<std::string> const &log_names)
 {
-    osmium::nwr_array<std::set<id_version_type>> objects_done;
+    osmium::nwr_array<std::vector<id_version_type>> objects_done;
 
     for (auto const &log : log_names) {
         auto const objects = read_log(log[0] == '/' ? "" : log_dir, log);
         for (auto const &obj : objects) {
-            objects_done(obj.type())
-                .insert(std::make_pair(obj.id(), obj.version()));
+            objects_done(obj.type()).emplace_back(obj.id(), obj.version());
         }
     }
 
+    for (auto const type : {osmium::item_type::node, osmium::item_type::way,
+                            osmium::item_type::relation}) {
+        sort_unique(objects_done(type));
+    }
+
     return objects_done;
 }
 
@@ -135,28 +268,44 @@ bool app(osmium::VerboseOutput &vout, Config const &config,
 
     vout << "Connecting to database...\n";
     pqxx::connection db{config.db_connection()};
-    db.prepare("node",
-               "SELECT node_id, version, changeset_id FROM nodes WHERE "
-               "\"timestamp\" >= $1 ORDER BY node_id, version;");
-    db.prepare("way",
-               "SELECT way_id, version, changeset_id FROM ways WHERE "
-               "\"timestamp\" >= $1 ORDER BY way_id, version;");
-    db.prepare("relation",
-               "SELECT relation_id, version, changeset_id FROM relations WHERE "
-               "\"timestamp\" >= $1 ORDER BY relation_id, version;");
-
-    pqxx::work txn{db};
-    vout << "Database version: " << get_db_version(txn) << '\n';
 
-    vout << "Reading changes...\n";
-    std::string data;
+    // This transaction exports its snapshot to the transactions reading
+    // the different object types in parallel, it has to stay open until
+    // they are all done.
+    pqxx::transaction<pqxx::repeatable_read> txn{db};
+    vout << "Database version: " << get_db_version(txn) << '\n';
+    std::string const snapshot =
+        txn.exec1("SELECT pg_export_snapshot()")[0].c_str();
+
+    auto const windows = split_time_range(
+        options.timestamp(), options.until(), options.interval());
+
+    // With sequential scans disabled the planner will still use one if
+    // there is no usable index, but not just because the table is small.
+    vout << "Checking query plans...\n";
+    txn.exec("SET LOCAL enable_seqscan = off");
+    for (auto const type : {osmium::item_type::node, osmium::item_type::way,
+                            osmium::item_type::relation}) {
+        check_query_plan(txn, type, windows.front(), options.by_changeset());
+    }
+    txn.exec("RESET enable_seqscan");
+
+    vout << "Reading changes in " << windows.size() << " time window(s)...\n";
+    osmium::nwr_array<std::vector<std::string>> data;
+    osmium::nwr_array<std::future<std::size_t>> results;
+    for (auto const type : {osmium::item_type::node, osmium::item_type::way,
+                            osmium::item_type::relation}) {
+        results(type) = std::async(
+            std::launch::async, read_objects, std::cref(config.db_connection()),
+            std::cref(snapshot), std::cref(windows), std::ref(data(type)),
+            type, options.by_changeset(), std::cref(objects_done(type)));
+    }
 
-    auto count = read_objects(txn, data, options.timestamp(),
-                              osmium::item_type::node, objects_done);
-    count += read_objects(txn, data, options.timestamp(),
-                          osmium::item_type::way, objects_done);
-    count += read_objects(txn, data, options.timestamp(),
-                          osmium::item_type::relation, objects_done);
+    std::size_t count = 0;
+    for (auto const type : {osmium::item_type::node, osmium::item_type::way,
+                            osmium::item_type::relation}) {
+        count += results(type).get();
+    }
 
     txn.commit();
 
@@ -166,12 +315,25 @@ bool app(osmium::VerboseOutput &vout, Config const &config,
     } else {
         vout << "There are " << count << " entries in the replication log.\n";
 
-        std::string const file_name =
-            create_replication_log_name(options.timestamp().to_iso());
-        vout << "Writing log to '" << config.log_dir() << file_name << "'...\n";
-
-        write_data_to_file(data, config.log_dir(), file_name);
-        vout << "Wrote and synced log.\n";
+        // The log files are only visible once all of them are synced.
+        DurableWriter durable;
+        for (std::size_t n = 0; n < windows.size(); ++n) {
+            std::string log{std::move(data(osmium::item_type::node)[n])};
+            log += data(osmium::item_type::way)[n];
+            log += data(osmium::item_type::relation)[n];
+            if (log.empty()) {
+                continue;
+            }
+
+            std::string const file_name =
+                create_replication_log_name(windows[n].start.to_iso());
+            vout << "Writing log to '" << config.log_dir() << file_name
+                 << "'...\n";
+
+            durable.add_data(config.log_dir() + file_name, log);
+        }
+        durable.commit();
+        vout << "Wrote and synced log(s).\n";
     }
 
     vout << "Done.\n";
@@ -0,0 +1,280 @@
+
+#include "config.hpp"
+#include "db.hpp"
+#include "exception.hpp"
+#include "io.hpp"
+#include "metrics.hpp"
+#include "options.hpp"
+#include "sequence.hpp"
+#include "util.hpp"
+
+#include <osmium/util/verbose_output.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+
+class MonitorOptions : public Options
+{
+public:
+    MonitorOptions()
+    : Options("monitor", "Write replication lag and backlog metrics.")
+    {}
+
+    unsigned int interval() const noexcept { return m_interval; }
+
+private:
+    void add_command_options(po::options_description &desc) override
+    {
+        po::options_description opts_cmd{"COMMAND OPTIONS"};
+
+        // clang-format off
+        opts_cmd.add_options()
+            ("interval,i", po::value<unsigned int>(), "Update metrics every SECONDS seconds (default: once)");
+        // clang-format on
+
+        desc.add(opts_cmd);
+    }
+
+    void check_command_options(
+        boost::program_options::variables_map const &vm) override
+    {
+        if (vm.count("interval")) {
+            m_interval = vm["interval"].as<unsigned int>();
+        }
+    }
+
+    unsigned int m_interval = 0;
+}; // class MonitorOptions
+
+static void add_slot_metrics(osmium::VerboseOutput &vout, Config const &config,
+                             Metrics &metrics)
+{
+    pqxx::connection db{config.db_connection()};
+
+    // These functions were renamed in PostgreSQL 10
+    if (db.server_version() >= 100000) {
+        db.prepare("slot",
+                   "SELECT active,"
+                   " pg_wal_lsn_diff(pg_current_wal_lsn(),"
+                   " confirmed_flush_lsn)::bigint,"
+                   " pg_wal_lsn_diff(pg_current_wal_lsn(), restart_lsn)::bigint"
+                   " FROM pg_replication_slots WHERE slot_name = $1;");
+    } else {
+        db.prepare("slot",
+                   "SELECT active,"
+                   " pg_xlog_location_diff(pg_current_xlog_location(),"
+                   " confirmed_flush_lsn)::bigint,"
+                   " pg_xlog_location_diff(pg_current_xlog_location(),"
+                   " restart_lsn)::bigint"
+                   " FROM pg_replication_slots WHERE slot_name = $1;");
+    }
+
+    pqxx::work txn{db};
+    pqxx::result const result =
+        txn.prepared("slot")(config.replication_slot()).exec();
+    txn.commit();
+
+    auto const label = metrics_label("slot", config.replication_slot());
+
+    metrics.gauge("osmdbt_replication_slot_exists",
+                  "Does the replication slot exist?", result.empty() ? 0 : 1,
+                  label);
+
+    if (result.empty()) {
+        vout << "Replication slot '" << config.replication_slot()
+             << "' not found.\n";
+        return;
+    }
+
+    auto const &row = result[0];
+    auto const lag = row[1].as<double>(0);
+    auto const retained = row[2].as<double>(0);
+
+    vout << "Replication slot '" << config.replication_slot()
+         << "': lag=" << lag << " bytes, retained WAL=" << retained
+         << " bytes\n";
+
+    metrics.gauge("osmdbt_replication_slot_active",
+                  "Is a client currently connected to the replication slot?",
+                  row[0].c_str()[0] == 't' ? 1 : 0, label);
+    metrics.gauge("osmdbt_replication_slot_lag_bytes",
+                  "Bytes of WAL not yet confirmed as read from the slot.", lag,
+                  label);
+    metrics.gauge("osmdbt_replication_slot_retained_wal_bytes",
+                  "Bytes of WAL the server has to keep for the slot.",
+                  retained, label);
+}
+
+/// Sort key of log files: by LSN, log files without LSN first by name.
+static std::pair<std::uint64_t, std::string>
+log_order(std::string const &name)
+{
+    return std::make_pair(lsn_from_log_file_name(name), name);
+}
+
+static void add_file_metrics(osmium::VerboseOutput &vout,
+                             Config const &config, Metrics &metrics)
+{
+    std::time_t const now = std::time(nullptr);
+
+    // In --sequence mode change files are not named after the log files.
+    // Instead osmdbt-create-diff records the log file published last, all
+    // log files up to that one are published.
+    auto const record = read_sequence_record(config.run_dir());
+    bool const sequence_mode = record.sequence > 0;
+
+    std::size_t logs = 0;
+    std::size_t pending_logs = 0;
+    std::time_t oldest_pending = now;
+    std::time_t newest = 0;
+
+    for (auto const &name : list_dir(config.log_dir())) {
+        if (!is_log_file_name(name)) {
+            continue;
+        }
+        ++logs;
+        auto const mtime = file_mtime(config.log_dir() + "/" + name);
+        newest = std::max(newest, mtime);
+        bool const published =
+            sequence_mode
+                ? !record.log_file_name.empty() &&
+                      log_order(name) <= log_order(record.log_file_name)
+                : file_exists(config.changes_dir() + "/" +
+                              replace_suffix(name, ".osc.gz"));
+        if (!published) {
+            ++pending_logs;
+            oldest_pending = std::min(oldest_pending, mtime);
+        }
+    }
+
+    // Change files still having the suffix ".new" are written but not
+    // published yet (for instance by osmdbt-backfill). In --sequence mode
+    // they can only be in the directory of the next sequence number and
+    // the change files are not counted, the tree of directories can be
+    // huge.
+    std::size_t diffs = 0;
+    std::size_t unpublished_diffs = 0;
+    auto const has_suffix = [](std::string const &name,
+                               std::string const &suffix) {
+        return name.size() > suffix.size() &&
+               name.compare(name.size() - suffix.size(), suffix.size(),
+                            suffix) == 0;
+    };
+    std::string const diff_dir =
+        sequence_mode ? config.changes_dir() + "/" +
+                            sequence_path(record.sequence + 1).substr(0, 7)
+                      : config.changes_dir();
+    if (!sequence_mode || file_exists(diff_dir)) {
+        for (auto const &name : list_dir(diff_dir)) {
+            if (has_suffix(name, ".osc.gz")) {
+                ++diffs;
+            } else if (has_suffix(name, ".osc.gz.new")) {
+                ++unpublished_diffs;
+            }
+        }
+    }
+
+    // The changes in the oldest pending log file are the oldest ones not
+    // published yet. Changes not read from the replication slot yet are
+    // not covered, see osmdbt_replication_slot_lag_bytes for those.
+    std::time_t const lag = pending_logs == 0 ? 0 : now - oldest_pending;
+
+    vout << "Log files: " << logs << " (" << pending_logs
+         << " without change file)\n";
+    if (sequence_mode) {
+        vout << "Last sequence number: " << record.sequence << " ("
+             << unpublished_diffs << " change files not published)\n";
+    } else {
+        vout << "Change files: " << diffs << " (" << unpublished_diffs
+             << " not published)\n";
+    }
+    vout << "Replication lag: " << lag << " seconds\n";
+
+    metrics.gauge("osmdbt_log_files", "Number of log files in log_dir.",
+                  static_cast<double>(logs));
+    metrics.gauge("osmdbt_pending_log_files",
+                  "Number of log files without a change file.",
+                  static_cast<double>(pending_logs));
+    metrics.gauge("osmdbt_oldest_pending_log_age_seconds",
+                  "Age of the oldest log file without a change file.",
+                  static_cast<double>(now - oldest_pending));
+    metrics.gauge("osmdbt_newest_log_age_seconds",
+                  "Age of the newest log file.",
+                  newest == 0 ? 0.0 : static_cast<double>(now - newest));
+    metrics.gauge("osmdbt_replication_lag_seconds",
+                  "Age of the oldest changes not published as change file.",
+                  static_cast<double>(lag));
+    if (sequence_mode) {
+        metrics.gauge("osmdbt_sequence_number",
+                      "Last sequence number published.",
+                      static_cast<double>(record.sequence));
+    } else {
+        metrics.gauge("osmdbt_diff_files",
+                      "Number of change files in changes_dir.",
+                      static_cast<double>(diffs));
+    }
+    metrics.gauge("osmdbt_unpublished_diff_files",
+                  "Number of change files written but not published yet.",
+                  static_cast<double>(unpublished_diffs));
+}
+
+static void update_metrics(osmium::VerboseOutput &vout, Config const &config)
+{
+    Metrics metrics;
+
+    bool database_up = true;
+    try {
+        add_slot_metrics(vout, config, metrics);
+    } catch (std::exception const &e) {
+        std::cerr << e.what() << '\n';
+        database_up = false;
+    }
+    metrics.gauge("osmdbt_database_up", "Could the database be queried?",
+                  database_up ? 1 : 0);
+
+    add_file_metrics(vout, config, metrics);
+
+    metrics.gauge("osmdbt_monitor_last_update_timestamp_seconds",
+                  "Time of the last metrics update.",
+                  static_cast<double>(std::time(nullptr)));
+
+    if (config.metrics_dir().empty()) {
+        std::cout << metrics.data();
+    } else {
+        metrics.write(config.metrics_dir(), "osmdbt-monitor");
+        vout << "Wrote metrics to '" << config.metrics_dir()
+             << "/osmdbt-monitor.prom'.\n";
+    }
+}
+
+bool app(osmium::VerboseOutput &vout, Config const &config,
+         MonitorOptions const &options)
+{
+    PIDFile pid_file{config.run_dir(), "osmdbt-monitor"};
+
+    while (true) {
+        update_metrics(vout, config);
+
+        if (options.interval() == 0) {
+            break;
+        }
+
+        std::this_thread::sleep_for(std::chrono::seconds{options.interval()});
+    }
+
+    vout << "Done.\n";
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    MonitorOptions options;
+    return app_wrapper(options, argc, argv);
+}
@@ -0,0 +1,310 @@
+
+#include "config.hpp"
+#include "db.hpp"
+#include "exception.hpp"
+#include "io.hpp"
+#include "metrics.hpp"
+#include "options.hpp"
+#include "osmobj.hpp"
+#include "sequence.hpp"
+#include "timewindow.hpp"
+#include "util.hpp"
+#include "version.hpp"
+
+#include <osmium/io/gzip_compression.hpp>
+#include <osmium/io/writer.hpp>
+#include <osmium/io/xml_output.hpp>
+#include <osmium/memory/buffer.hpp>
+#include <osmium/osm/timestamp.hpp>
+#include <osmium/osm/types.hpp>
+#include <osmium/util/memory.hpp>
+#include <osmium/util/verbose_output.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+class RebuildDiffsOptions : public Options
+{
+public:
+    RebuildDiffsOptions()
+    : Options("rebuild-diffs",
+              "Create replication diff files for a past time range.")
+    {}
+
+    osmium::Timestamp from() const noexcept { return m_from; }
+
+    osmium::Timestamp to() const noexcept { return m_to; }
+
+    std::time_t interval() const noexcept { return m_interval; }
+
+    std::size_t max_writers() const noexcept { return m_max_writers; }
+
+    std::uint64_t first_sequence() const noexcept { return m_first_sequence; }
+
+private:
+    void add_command_options(po::options_description &desc) override
+    {
+        po::options_description opts_cmd{"COMMAND OPTIONS"};
+
+        // clang-format off
+        opts_cmd.add_options()
+            ("from,t", po::value<std::string>(), "Start of time range (required)")
+            ("to,u", po::value<std::string>(), "End of time range (required)")
+            ("interval,i", po::value<unsigned int>(), "Write one diff per this many seconds (default: 60)")
+            ("max-writers,w", po::value<std::size_t>(), "Maximum number of diffs written in parallel (default: 16)")
+            ("first-sequence", po::value<std::uint64_t>(), "Write diffs into replication directories starting with this sequence number");
+        // clang-format on
+
+        desc.add(opts_cmd);
+    }
+
+    void check_command_options(
+        boost::program_options::variables_map const &vm) override
+    {
+        if (vm.count("from")) {
+            m_from = osmium::Timestamp{vm["from"].as<std::string>()};
+        } else {
+            throw argument_error{
+                "Missing '--from=TIMESTAMP' or '-t TIMESTAMP' on command line"};
+        }
+
+        if (vm.count("to")) {
+            m_to = osmium::Timestamp{vm["to"].as<std::string>()};
+        } else {
+            throw argument_error{
+                "Missing '--to=TIMESTAMP' or '-u TIMESTAMP' on command line"};
+        }
+
+        if (m_to <= m_from) {
+            throw argument_error{
+                "Timestamp set with --to must be after --from"};
+        }
+
+        if (vm.count("interval")) {
+            m_interval = vm["interval"].as<unsigned int>();
+            if (m_interval == 0) {
+                throw argument_error{"Interval must be at least one second"};
+            }
+        }
+
+        if (vm.count("max-writers")) {
+            m_max_writers = vm["max-writers"].as<std::size_t>();
+            if (m_max_writers == 0) {
+                throw argument_error{
+                    "Maximum number of writers must be at least 1"};
+            }
+        }
+
+        if (vm.count("first-sequence")) {
+            m_first_sequence = vm["first-sequence"].as<std::uint64_t>();
+            if (m_first_sequence == 0) {
+                throw argument_error{"Sequence numbers start at 1"};
+            }
+        }
+    }
+
+    osmium::Timestamp m_from{};
+    osmium::Timestamp m_to{};
+    std::time_t m_interval = 60;
+    std::size_t m_max_writers = 16;
+    std::uint64_t m_first_sequence = 0;
+
+}; // class RebuildDiffsOptions
+
+/// Output for the diff of one time window.
+struct diff_output
+{
+    std::string file_name;
+    std::unique_ptr<osmium::io::Writer> writer;
+    osmium::memory::Buffer buffer;
+    std::size_t count = 0;
+};
+
+bool app(osmium::VerboseOutput &vout, Config const &config,
+         RebuildDiffsOptions const &options)
+{
+    auto const start_time = std::chrono::steady_clock::now();
+    PIDFile pid_file{config.run_dir(), "osmdbt-rebuild-diffs"};
+
+    vout << "Connecting to database...\n";
+    pqxx::connection db{config.db_connection()};
+    db.prepare("changeset_users",
+               "SELECT c.id, c.user_id, u.display_name FROM changesets c, "
+               "users u WHERE c.user_id = u.id AND c.id = ANY($1::bigint[])");
+
+    // All queries see the same database state.
+    pqxx::transaction<pqxx::repeatable_read> txn{db};
+    vout << "Database version: " << get_db_version(txn) << '\n';
+
+    auto const windows =
+        split_time_range(options.from(), options.to(), options.interval());
+    vout << "Rebuilding " << windows.size() << " diffs...\n";
+
+    osmium::io::Header header;
+    header.set_has_multiple_object_versions(true);
+    header.set("generator",
+               std::string{"osmdbt-rebuild-diffs/"} + get_osmdbt_version());
+
+    constexpr std::size_t const buffer_size = 1024UL * 1024UL;
+    std::size_t count = 0;
+    changeset_user_lookup cucache;
+    DurableWriter durable;
+
+    // The time range is read in groups of consecutive windows, each with
+    // one query per object type. The objects are distributed to the diffs
+    // of their windows which are written in parallel.
+    for (std::size_t first = 0; first < windows.size();
+         first += options.max_writers()) {
+        std::size_t const last =
+            std::min(first + options.max_writers(), windows.size());
+
+        std::vector<diff_output> outputs(last - first);
+        for (std::size_t n = first; n < last; ++n) {
+            auto &output = outputs[n - first];
+            if (options.first_sequence()) {
+                auto const sequence = options.first_sequence() + n;
+                create_sequence_dirs(config.changes_dir(), sequence);
+                output.file_name = config.changes_dir() + "/" +
+                                   sequence_path(sequence) + ".osc.gz";
+            } else {
+                // named after the window only, so a rebuild of the same
+                // range gives the same names
+                output.file_name = replace_suffix(
+                    config.changes_dir() +
+                        create_replication_log_name(
+                            windows[n].end.to_iso(),
+                            windows[n].start.seconds_since_epoch()),
+                    ".osc.gz");
+            }
+            output.writer.reset(new osmium::io::Writer{
+                osmium::io::File{output.file_name + ".new", "osc.gz"},
+                header, osmium::io::overwrite::no, osmium::io::fsync::no});
+            output.buffer = osmium::memory::Buffer{buffer_size};
+        }
+
+        time_window const range{windows[first].start, windows[last - 1].end};
+        vout << "Reading changes from " << range.start.to_iso() << " to "
+             << range.end.to_iso() << "...\n";
+
+        for (auto const type :
+             {osmium::item_type::node, osmium::item_type::way,
+              osmium::item_type::relation}) {
+            std::string const name{osmium::item_type_to_name(type)};
+            std::string const condition{
+                "o.\"timestamp\" >= " + txn.quote(range.start.to_iso()) +
+                " AND o.\"timestamp\" < " + txn.quote(range.end.to_iso()) +
+                " ORDER BY o." + name + "_id, o.version"};
+
+            pqxx::icursorstream stream{
+                txn, composite_query(type, condition.c_str()),
+                "osmdbt_rebuild_" + name + "s", 10000};
+
+            pqxx::result rows;
+            while (stream >> rows, !rows.empty()) {
+                lookup_changeset_users(txn, rows, cucache);
+                for (auto const &row : rows) {
+                    auto const cid = row[2].as<osmium::changeset_id_type>();
+                    auto const &user = cucache.at(cid);
+                    if (user.id == 0) {
+                        throw database_error{"Unknown user for changeset " +
+                                             std::to_string(cid)};
+                    }
+
+                    auto const seconds =
+                        row[4].as<std::time_t>() -
+                        range.start.seconds_since_epoch();
+                    auto const index =
+                        static_cast<std::size_t>(seconds) /
+                        static_cast<std::size_t>(options.interval());
+                    if (seconds < 0 || index >= outputs.size()) {
+                        throw database_error{
+                            "Timestamp of " + name + " " +
+                            row[0].as<std::string>() + " v" +
+                            row[1].as<std::string>() +
+                            " outside of time range"};
+                    }
+                    auto &output = outputs[index];
+
+                    osmobj::build_composite(type, output.buffer, row, user);
+                    ++output.count;
+                    if (output.buffer.committed() > buffer_size / 10 * 9) {
+                        (*output.writer)(std::move(output.buffer));
+                        output.buffer = osmium::memory::Buffer{buffer_size};
+                    }
+                }
+            }
+        }
+
+        // All diffs and state files of the group are synced together.
+        for (std::size_t n = first; n < last; ++n) {
+            auto &output = outputs[n - first];
+            if (output.buffer.committed() > 0) {
+                (*output.writer)(std::move(output.buffer));
+            }
+            output.writer->close();
+            durable.add_file(output.file_name + ".new", output.file_name);
+            count += output.count;
+
+            if (options.first_sequence()) {
+                auto const sequence = options.first_sequence() + n;
+                durable.add_data(config.changes_dir() + "/" +
+                                     sequence_path(sequence) + ".state.txt",
+                                 state_file_content(sequence, windows[n].end));
+            }
+        }
+        durable.commit();
+
+        vout << "  Wrote " << outputs.size() << " diffs.\n";
+
+        // changesets are mostly clustered in time, so we don't need to
+        // keep all of them
+        if (cucache.size() > 1000000) {
+            cucache.clear();
+        }
+    }
+
+    txn.commit();
+
+    vout << "Wrote and synced " << windows.size() << " diffs with " << count
+         << " objects.\n";
+    vout << "Synced " << durable.file_syncs() << " files and "
+         << durable.dir_syncs() << " directories.\n";
+
+    if (!config.metrics_dir().empty()) {
+        std::chrono::duration<double> const duration =
+            std::chrono::steady_clock::now() - start_time;
+
+        Metrics metrics;
+        metrics.gauge("osmdbt_rebuild_diffs_objects",
+                      "Number of objects written in the last run.",
+                      static_cast<double>(count));
+        metrics.gauge("osmdbt_rebuild_diffs_files",
+                      "Number of diffs written in the last run.",
+                      static_cast<double>(windows.size()));
+        metrics.gauge("osmdbt_rebuild_diffs_duration_seconds",
+                      "Duration of the last run.", duration.count());
+        metrics.write(config.metrics_dir(), "osmdbt-rebuild-diffs");
+        vout << "Wrote metrics.\n";
+    }
+
+    osmium::MemoryUsage mem;
+    vout << "Current memory used: " << mem.current() << " MBytes\n";
+    vout << "Peak memory used: " << mem.peak() << " MBytes\n";
+
+    vout << "Done.\n";
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    RebuildDiffsOptions options;
+    return app_wrapper(options, argc, argv);
+}
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <iterator>
 
 osmobj::osmobj(std::string const &obj, std::string const &version,
                std::string const &changeset, changeset_user_lookup *cucache)
@@ -39,87 +40,192 @@ osmobj::osmobj(std::string const &obj, std::string const &version,
 }
 
 void osmobj::get_data(pqxx::work &txn, osmium::memory::Buffer &buffer,
-                      changeset_user_lookup const &cucache) const
+                      changeset_user_lookup const &cucache,
+                      fetch_mode mode) const
 {
+    char const *const statement = osmium::item_type_to_name(m_type);
+
+    if (mode == fetch_mode::composite) {
+        std::string const composite_statement{statement +
+                                              std::string{"_composite"}};
+        pqxx::result const result =
+            exec_timed(composite_statement.c_str(),
+                       txn.prepared(composite_statement)(m_id)(m_version));
+        if (result.size() != 1) {
+            throw database_error{"Expected exactly one result (get_data)."};
+        }
+        auto const cid = result[0][2].as<osmium::changeset_id_type>();
+        build_composite(m_type, buffer, result[0], cucache.at(cid));
+        return;
+    }
+
     pqxx::result const result =
-        txn.prepared(osmium::item_type_to_name(m_type))(m_id)(m_version).exec();
+        exec_timed(statement, txn.prepared(statement)(m_id)(m_version));
 
     assert(result.size() == 1);
     if (result.size() != 1) {
         throw database_error{"Expected exactly one result (get_data)."};
     }
-    auto const &row = result[0];
-
-    auto const cid = row["changeset_id"].as<osmium::changeset_id_type>();
-    bool const visible = row["visible"].c_str()[0] == 't';
-    auto const &user = cucache.at(cid);
-    char const *const timestamp = row["timestamp"].c_str();
-
-    switch (m_type) {
-    case osmium::item_type::node: {
-        osmium::builder::NodeBuilder builder{buffer};
-        set_attributes(builder, cid, visible, user.id, timestamp);
-        osmium::Location loc{row["longitude"].as<int64_t>(),
-                             row["latitude"].as<int64_t>()};
-        builder.set_location(loc).set_user(user.username);
-        add_tags(txn, builder);
-    } break;
-    case osmium::item_type::way: {
-        osmium::builder::WayBuilder builder{buffer};
-        set_attributes(builder, cid, visible, user.id, timestamp);
-        builder.set_user(user.username);
-        add_nodes(txn, builder);
-        add_tags(txn, builder);
-    } break;
-    case osmium::item_type::relation: {
-        osmium::builder::RelationBuilder builder{buffer};
-        set_attributes(builder, cid, visible, user.id, timestamp);
-        builder.set_user(user.username);
-        add_members(txn, builder);
-        add_tags(txn, builder);
-    } break;
-    default:
-        assert(false);
-    }
-
-    buffer.commit();
+
+    std::string const tag_statement{statement + std::string{"_tag"}};
+    pqxx::result const tags = exec_timed(
+        tag_statement.c_str(), txn.prepared(tag_statement)(m_id)(m_version));
+
+    pqxx::result list;
+    if (m_type != osmium::item_type::node) {
+        char const *list_statement = nullptr;
+        if (m_type == osmium::item_type::way) {
+            list_statement =
+                mode == fetch_mode::arrays ? "way_nodes_array" : "way_nodes";
+        } else {
+            list_statement =
+                mode == fetch_mode::arrays ? "members_array" : "members";
+        }
+        list = exec_timed(list_statement,
+                          txn.prepared(list_statement)(m_id)(m_version));
+    }
+
+    build(buffer, cucache, result[0], tags, list, mode);
+}
+
+void osmobj::add_tags_from_arrays(char const *keys, char const *values,
+                                  osmium::builder::Builder &builder)
+{
+    osmium::builder::TagListBuilder tbuilder{builder};
+    ArrayReader key_reader{keys};
+    ArrayReader value_reader{values};
+
+    std::string key;
+    std::string value;
+    while (key_reader.next(key)) {
+        if (!value_reader.next(value)) {
+            throw database_error{"Tag arrays have different lengths."};
+        }
+        tbuilder.add_tag(key, value);
+    }
 }
 
-void osmobj::add_nodes(pqxx::work &txn,
-                       osmium::builder::WayBuilder &builder) const
+void osmobj::add_nodes_from_array(char const *node_ids,
+                                  osmium::builder::WayBuilder &builder)
 {
     osmium::builder::WayNodeListBuilder wnbuilder{builder};
-    pqxx::result const result =
-        txn.prepared("way_nodes")(m_id)(m_version).exec();
-
-    for (auto const &row : result) {
-        wnbuilder.add_node_ref(row[0].as<osmium::object_id_type>());
+    ArrayReader reader{node_ids};
+    std::int64_t id = 0;
+    while (reader.next_int(id)) {
+        wnbuilder.add_node_ref(id);
     }
 }
 
-void osmobj::add_members(pqxx::work &txn,
-                         osmium::builder::RelationBuilder &builder) const
+void osmobj::add_members_from_arrays(char const *types, char const *ids,
+                                     char const *roles,
+                                     osmium::builder::RelationBuilder &builder)
 {
     osmium::builder::RelationMemberListBuilder mbuilder{builder};
-    pqxx::result const result = txn.prepared("members")(m_id)(m_version).exec();
+    ArrayReader type_reader{types};
+    ArrayReader id_reader{ids};
+    ArrayReader role_reader{roles};
 
-    for (auto const &row : result) {
-        osmium::item_type type;
-        switch (*row[0].c_str()) {
-        case 'N':
-            type = osmium::item_type::node;
-            break;
-        case 'W':
-            type = osmium::item_type::way;
-            break;
-        case 'R':
-            type = osmium::item_type::relation;
-            break;
-        default:
-            assert(false);
+    std::string type;
+    std::int64_t id = 0;
+    std::string role;
+    while (type_reader.next(type)) {
+        if (!id_reader.next_int(id) || !role_reader.next(role)) {
+            throw database_error{"Member arrays have different lengths."};
+        }
+        mbuilder.add_member(member_type(type.c_str()), id, role.c_str(),
+                            role.size());
+    }
+}
+
+/**
+ * Build the query for composite_query() or current_query(). In the
+ * current tables the id column of the object tables is called "id" and the
+ * tag, way node, and member tables don't have a version column.
+ */
+static std::string build_composite_query(osmium::item_type type,
+                                         char const *condition, bool current)
+{
+    std::string const name{osmium::item_type_to_name(type)};
+    std::string const prefix{current ? "current_" : ""};
+    std::string const id_column{current ? "o.id" : "o." + name + "_id"};
+    std::string const key{current ? name + "_id = o.id"
+                                  : "(" + name + "_id, version) = (" +
+                                        id_column + ", o.version)"};
+
+    std::string query{
+        "SELECT " + id_column +
+        ", o.version, o.changeset_id, o.visible,"
+        " floor(extract(epoch from o.timestamp))::bigint AS timestamp"};
+
+    if (type == osmium::item_type::node) {
+        query += ", o.longitude, o.latitude";
+    }
+
+    query += ", t.keys, t.vals";
+
+    if (type == osmium::item_type::way) {
+        query += ", l.nodes";
+    } else if (type == osmium::item_type::relation) {
+        query += ", l.types, l.ids, l.roles";
+    }
+
+    query += " FROM " + prefix + name + "s o CROSS JOIN LATERAL (SELECT"
+             " array_agg(k ORDER BY k) AS keys, array_agg(v ORDER BY k) AS vals"
+             " FROM " + prefix + name + "_tags WHERE " + key + ") t";
+
+    if (type == osmium::item_type::way) {
+        query += " CROSS JOIN LATERAL (SELECT"
+                 " array_agg(node_id ORDER BY sequence_id) AS nodes"
+                 " FROM " + prefix + "way_nodes WHERE " + key + ") l";
+    } else if (type == osmium::item_type::relation) {
+        query += " CROSS JOIN LATERAL (SELECT"
+                 " array_agg(member_type ORDER BY sequence_id) AS types,"
+                 " array_agg(member_id ORDER BY sequence_id) AS ids,"
+                 " array_agg(member_role ORDER BY sequence_id) AS roles"
+                 " FROM " + prefix + "relation_members WHERE " + key + ") l";
+    }
+
+    query += " WHERE ";
+    query += condition;
+
+    return query;
+}
+
+std::string composite_query(osmium::item_type type, char const *condition)
+{
+    return build_composite_query(type, condition, false);
+}
+
+std::string current_query(osmium::item_type type, char const *condition)
+{
+    return build_composite_query(type, condition, true);
+}
+
+void lookup_changeset_users(pqxx::transaction_base &txn,
+                            pqxx::result const &rows,
+                            changeset_user_lookup &cucache)
+{
+    std::string ids;
+    for (auto const &row : rows) {
+        auto const cid = row[2].as<osmium::changeset_id_type>();
+        if (cucache.count(cid) == 0) {
+            cucache[cid];
+            ids += ids.empty() ? '{' : ',';
+            ids += row[2].c_str();
         }
-        mbuilder.add_member(type, row[1].as<osmium::object_id_type>(),
-                            row[2].c_str());
+    }
+
+    if (ids.empty()) {
+        return;
+    }
+    ids += '}';
+
+    pqxx::result const result = exec_timed(
+        "changeset_users", txn.prepared("changeset_users")(ids));
+    for (auto const &row : result) {
+        auto &user = cucache[row[0].as<osmium::changeset_id_type>()];
+        user.id = row[1].as<osmium::user_id_type>();
+        user.username = row[2].c_str();
     }
 }
 
@@ -161,3 +267,57 @@ std::vector<osmobj> read_log(std::string const &dir_name,
 
     return objects_todo;
 }
+
+static bool same_object(osmobj const &a, osmobj const &b) noexcept
+{
+    return a.type() == b.type() && a.id() == b.id();
+}
+
+/// Find the last entry of the same object starting at it.
+static std::vector<osmobj>::const_iterator
+last_version(std::vector<osmobj>::const_iterator it,
+             std::vector<osmobj>::const_iterator end)
+{
+    auto next = std::next(it);
+    while (next != end && same_object(*it, *next)) {
+        it = next;
+        ++next;
+    }
+    return it;
+}
+
+std::vector<osmobj> created_objects(std::vector<osmobj> const &objects)
+{
+    std::vector<osmobj> created;
+
+    for (auto it = objects.begin(); it != objects.end(); ++it) {
+        auto const last = last_version(it, objects.end());
+        if (it->version() == 1 && last->version() > 1) {
+            created.push_back(*last);
+        }
+        it = last;
+    }
+
+    return created;
+}
+
+std::vector<osmobj> squash_versions(std::vector<osmobj> const &objects,
+                                    std::vector<osmobj> const &deleted)
+{
+    std::vector<osmobj> squashed;
+
+    for (auto it = objects.begin(); it != objects.end(); ++it) {
+        auto const last = last_version(it, objects.end());
+        if (it->version() == 1 && last->version() > 1) {
+            if (std::binary_search(deleted.begin(), deleted.end(), *last)) {
+                it = last;
+                continue;
+            }
+            squashed.push_back(*it);
+        }
+        squashed.push_back(*last);
+        it = last;
+    }
+
+    return squashed;
+}
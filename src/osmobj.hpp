@@ -1,11 +1,15 @@
 #pragma once
 
+#include "array.hpp"
 #include "db.hpp"
 #include "exception.hpp"
 
 #include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/osm/timestamp.hpp>
 #include <osmium/osm/types.hpp>
 
+#include <cassert>
+#include <cstdint>
 #include <stdexcept>
 #include <string>
 #include <tuple>
@@ -21,6 +25,38 @@ struct userinfo
 using changeset_user_lookup =
     std::unordered_map<osmium::changeset_id_type, userinfo>;
 
+/**
+ * How way nodes and relation members are fetched from the database: One
+ * row per way node/member ("way_nodes" and "members" queries) or all of
+ * them aggregated into arrays in a single row ("way_nodes_array" and
+ * "members_array" queries). In composite mode the object, its tags, and
+ * way nodes or members are all fetched with a single query per object
+ * ("node_composite", "way_composite", "relation_composite" queries created
+ * with composite_query()).
+ */
+enum class fetch_mode
+{
+    rows,
+    arrays,
+    composite
+};
+
+/**
+ * Return a query for the objects of the specified type from the history
+ * tables matching the condition (an SQL expression using the alias "o" for
+ * the nodes, ways, or relations table, optionally followed by an ORDER BY
+ * clause). The result rows can be built into objects with
+ * osmobj::build_composite().
+ */
+std::string composite_query(osmium::item_type type, char const *condition);
+
+/**
+ * Like composite_query(), but for the current_* tables which contain only
+ * the newest version of each object. The id column of the current_nodes,
+ * current_ways, or current_relations table is "o.id".
+ */
+std::string current_query(osmium::item_type type, char const *condition);
+
 class osmobj
 {
 public:
@@ -28,21 +64,142 @@ public:
                     std::string const &changeset,
                     changeset_user_lookup *cucache = nullptr);
 
+    osmobj(osmium::item_type type, osmium::object_id_type id,
+           osmium::object_version_type version,
+           osmium::changeset_id_type cid = 0) noexcept
+    : m_type(type), m_id(id), m_version(version), m_cid(cid)
+    {}
+
     osmium::item_type type() const noexcept { return m_type; }
     osmium::object_id_type id() const noexcept { return m_id; }
     osmium::object_version_type version() const noexcept { return m_version; }
     osmium::changeset_id_type cid() const noexcept { return m_cid; }
 
-    void add_nodes(pqxx::work &txn, osmium::builder::WayBuilder &builder) const;
-    void add_members(pqxx::work &txn,
-                     osmium::builder::RelationBuilder &builder) const;
     void get_data(pqxx::work &txn, osmium::memory::Buffer &buffer,
-                  changeset_user_lookup const &cucache) const;
+                  changeset_user_lookup const &cucache,
+                  fetch_mode mode = fetch_mode::rows) const;
+
+    /**
+     * Build the object in the buffer from query results. The row has the
+     * columns of the "node", "way", or "relation" query, the tags are the
+     * result of the "*_tag" query and the list is the result of the
+     * "way_nodes" or "members" query (not used for nodes). In arrays mode
+     * the list is the result of the "way_nodes_array" or "members_array"
+     * query.
+     *
+     * The rows can be from a pqxx::result or anything else with the same
+     * interface (used by the benchmarks).
+     */
+    template <typename TRow, typename TRows>
+    void build(osmium::memory::Buffer &buffer,
+               changeset_user_lookup const &cucache, TRow const &row,
+               TRows const &tags, TRows const &list,
+               fetch_mode mode = fetch_mode::rows) const
+    {
+        // columns: id, version, changeset_id, visible, timestamp (as
+        //          seconds since the epoch), (nodes only:) longitude, latitude
+        auto const cid = row[2].template as<osmium::changeset_id_type>();
+        bool const visible = row[3].c_str()[0] == 't';
+        auto const &user = cucache.at(cid);
+        osmium::Timestamp const timestamp{row[4].template as<uint32_t>()};
+
+        switch (m_type) {
+        case osmium::item_type::node: {
+            osmium::builder::NodeBuilder builder{buffer};
+            set_attributes(builder, cid, visible, user.id, timestamp);
+            osmium::Location loc{row[5].template as<int64_t>(),
+                                 row[6].template as<int64_t>()};
+            builder.set_location(loc).set_user(user.username);
+            add_tags(tags, builder);
+        } break;
+        case osmium::item_type::way: {
+            osmium::builder::WayBuilder builder{buffer};
+            set_attributes(builder, cid, visible, user.id, timestamp);
+            builder.set_user(user.username);
+            if (mode == fetch_mode::arrays) {
+                add_nodes_from_array(list[0][0].c_str(), builder);
+            } else {
+                add_nodes(list, builder);
+            }
+            add_tags(tags, builder);
+        } break;
+        case osmium::item_type::relation: {
+            osmium::builder::RelationBuilder builder{buffer};
+            set_attributes(builder, cid, visible, user.id, timestamp);
+            builder.set_user(user.username);
+            if (mode == fetch_mode::arrays) {
+                add_members_from_arrays(list[0][0].c_str(),
+                                        list[0][1].c_str(),
+                                        list[0][2].c_str(), builder);
+            } else {
+                add_members(list, builder);
+            }
+            add_tags(tags, builder);
+        } break;
+        default:
+            assert(false);
+        }
+
+        buffer.commit();
+    }
+
+    /**
+     * Build an object of the given type from a row of a query created with
+     * composite_query(). The changeset of the object must have been
+     * created by the given user.
+     */
+    template <typename TRow>
+    static void build_composite(osmium::item_type type,
+                                osmium::memory::Buffer &buffer,
+                                TRow const &row, userinfo const &user)
+    {
+        // columns: id, version, changeset_id, visible, timestamp, then
+        //   for nodes: longitude, latitude, tag keys, tag values
+        //   for ways: tag keys, tag values, node ids
+        //   for relations: tag keys, tag values, member types, member ids,
+        //                  member roles
+        auto const id = row[0].template as<osmium::object_id_type>();
+        auto const version = row[1].template as<osmium::object_version_type>();
+        auto const cid = row[2].template as<osmium::changeset_id_type>();
+        bool const visible = row[3].c_str()[0] == 't';
+        osmium::Timestamp const timestamp{row[4].template as<uint32_t>()};
+        osmobj const obj{type, id, version, cid};
+
+        switch (type) {
+        case osmium::item_type::node: {
+            osmium::builder::NodeBuilder builder{buffer};
+            obj.set_attributes(builder, cid, visible, user.id, timestamp);
+            osmium::Location loc{row[5].template as<int64_t>(),
+                                 row[6].template as<int64_t>()};
+            builder.set_location(loc).set_user(user.username);
+            add_tags_from_arrays(row[7].c_str(), row[8].c_str(), builder);
+        } break;
+        case osmium::item_type::way: {
+            osmium::builder::WayBuilder builder{buffer};
+            obj.set_attributes(builder, cid, visible, user.id, timestamp);
+            builder.set_user(user.username);
+            add_nodes_from_array(row[7].c_str(), builder);
+            add_tags_from_arrays(row[5].c_str(), row[6].c_str(), builder);
+        } break;
+        case osmium::item_type::relation: {
+            osmium::builder::RelationBuilder builder{buffer};
+            obj.set_attributes(builder, cid, visible, user.id, timestamp);
+            builder.set_user(user.username);
+            add_members_from_arrays(row[7].c_str(), row[8].c_str(),
+                                    row[9].c_str(), builder);
+            add_tags_from_arrays(row[5].c_str(), row[6].c_str(), builder);
+        } break;
+        default:
+            assert(false);
+        }
+
+        buffer.commit();
+    }
 
     template <typename TBuilder>
     void set_attributes(TBuilder &builder, osmium::changeset_id_type const cid,
                         bool const visible, osmium::user_id_type const uid,
-                        char const *const timestamp) const
+                        osmium::Timestamp const timestamp) const
     {
         builder.set_id(m_id)
             .set_version(m_version)
@@ -52,20 +209,66 @@ public:
             .set_timestamp(timestamp);
     }
 
-    template <typename TBuilder>
-    void add_tags(pqxx::work &txn, TBuilder &builder) const
+    template <typename TRows, typename TBuilder>
+    static void add_tags(TRows const &rows, TBuilder &builder)
     {
         osmium::builder::TagListBuilder tbuilder{builder};
-        pqxx::result const result =
-            txn.prepared(osmium::item_type_to_name(m_type) +
-                         std::string{"_tag"})(m_id)(m_version)
-                .exec();
-
-        for (auto const &row : result) {
+        for (auto const &row : rows) {
             tbuilder.add_tag(row[0].c_str(), row[1].c_str());
         }
     }
 
+    template <typename TRows>
+    static void add_nodes(TRows const &rows,
+                          osmium::builder::WayBuilder &builder)
+    {
+        osmium::builder::WayNodeListBuilder wnbuilder{builder};
+        for (auto const &row : rows) {
+            wnbuilder.add_node_ref(
+                row[0].template as<osmium::object_id_type>());
+        }
+    }
+
+    template <typename TRows>
+    static void add_members(TRows const &rows,
+                            osmium::builder::RelationBuilder &builder)
+    {
+        osmium::builder::RelationMemberListBuilder mbuilder{builder};
+        for (auto const &row : rows) {
+            mbuilder.add_member(member_type(row[0].c_str()),
+                                row[1].template as<osmium::object_id_type>(),
+                                row[2].c_str());
+        }
+    }
+
+    static void add_tags_from_arrays(char const *keys, char const *values,
+                                     osmium::builder::Builder &builder);
+
+    static void add_nodes_from_array(char const *node_ids,
+                                     osmium::builder::WayBuilder &builder);
+
+    static void
+    add_members_from_arrays(char const *types, char const *ids,
+                            char const *roles,
+                            osmium::builder::RelationBuilder &builder);
+
+    /// Convert the member type from the database ('Node', 'Way', 'Relation').
+    static osmium::item_type member_type(char const *str) noexcept
+    {
+        switch (*str) {
+        case 'N':
+            return osmium::item_type::node;
+        case 'W':
+            return osmium::item_type::way;
+        case 'R':
+            return osmium::item_type::relation;
+        default:
+            break;
+        }
+        assert(false);
+        return osmium::item_type::undefined;
+    }
+
     using osmobj_tuple = std::tuple<unsigned int, osmium::object_id_type,
                                     osmium::object_version_type>;
 
@@ -103,6 +306,33 @@ private:
 
 }; // class osmobj
 
+/**
+ * Look up the users of the changesets (in column 2) of all rows not in the
+ * cache yet with a single query. The prepared statement "changeset_users"
+ * must return the changeset id, user id, and user name for all changesets
+ * in its parameter, an array of changeset ids.
+ */
+void lookup_changeset_users(pqxx::transaction_base &txn,
+                            pqxx::result const &rows,
+                            changeset_user_lookup &cucache);
+
 std::vector<osmobj> read_log(std::string const &dir_name,
                              std::string const &file_name,
                              changeset_user_lookup *cucache = nullptr);
+
+/**
+ * Return the last versions of all objects in the (sorted) list that were
+ * created in the list, ie. whose first version in the list is 1 and that
+ * have later versions in the list, too. The result is sorted.
+ */
+std::vector<osmobj> created_objects(std::vector<osmobj> const &objects);
+
+/**
+ * Collapse the (sorted) list of objects to the last version of each
+ * object. Objects created in the list keep their version 1 in front of the
+ * last version, so they are still marked as created in the diff. Objects
+ * created in the list whose last version is in the (sorted) list of
+ * deleted objects are removed completely.
+ */
+std::vector<osmobj> squash_versions(std::vector<osmobj> const &objects,
+                                    std::vector<osmobj> const &deleted);
@@ -0,0 +1,153 @@
+#include "region.hpp"
+
+#include <osmium/osm/node.hpp>
+#include <osmium/osm/relation.hpp>
+#include <osmium/osm/way.hpp>
+
+#include <algorithm>
+
+RegionFilter::RegionFilter(std::vector<region_config> const &regions)
+: m_node_ids(regions.size()), m_way_ids(regions.size()),
+  m_relation_ids(regions.size()), m_previous_node_ids(regions.size()),
+  m_previous_way_ids(regions.size()), m_previous_relation_ids(regions.size())
+{
+    for (auto const &region : regions) {
+        m_boxes.push_back(region.box);
+    }
+}
+
+static bool contains(osmium::Box const &box, osmium::Location location)
+{
+    return location.valid() && box.contains(location);
+}
+
+static bool contains(std::vector<osmium::object_id_type> const &ids,
+                     osmium::object_id_type id)
+{
+    return std::binary_search(ids.begin(), ids.end(), id);
+}
+
+static void add_id(std::vector<osmium::object_id_type> &ids,
+                   osmium::object_id_type id)
+{
+    // objects can be in the diff in several versions
+    if (ids.empty() || ids.back() != id) {
+        ids.push_back(id);
+    }
+}
+
+std::vector<osmium::object_id_type> &
+RegionFilter::ids(osmium::item_type type, std::size_t n)
+{
+    switch (type) {
+    case osmium::item_type::node:
+        return m_node_ids[n];
+    case osmium::item_type::way:
+        return m_way_ids[n];
+    default:
+        break;
+    }
+    return m_relation_ids[n];
+}
+
+std::vector<osmium::object_id_type> &
+RegionFilter::previous_ids(osmium::item_type type, std::size_t n)
+{
+    switch (type) {
+    case osmium::item_type::node:
+        return m_previous_node_ids[n];
+    case osmium::item_type::way:
+        return m_previous_way_ids[n];
+    default:
+        break;
+    }
+    return m_previous_relation_ids[n];
+}
+
+/**
+ * Is the object in region n because of its own location, the location of
+ * its way nodes, or its members (in the diff or in previous versions)?
+ */
+bool RegionFilter::in_region(osmium::OSMObject const &object,
+                             std::size_t n) const
+{
+    switch (object.type()) {
+    case osmium::item_type::node:
+        return contains(m_boxes[n],
+                        static_cast<osmium::Node const &>(object).location());
+    case osmium::item_type::way: {
+        auto const &way = static_cast<osmium::Way const &>(object);
+        return std::any_of(
+            way.nodes().cbegin(), way.nodes().cend(),
+            [&](osmium::NodeRef const &node_ref) {
+                return contains(m_boxes[n], node_ref.location()) ||
+                       contains(m_node_ids[n], node_ref.ref()) ||
+                       contains(m_previous_node_ids[n], node_ref.ref());
+            });
+    }
+    case osmium::item_type::relation: {
+        auto const &relation = static_cast<osmium::Relation const &>(object);
+        return std::any_of(
+            relation.members().begin(), relation.members().end(),
+            [&](osmium::RelationMember const &member) {
+                switch (member.type()) {
+                case osmium::item_type::node:
+                    return contains(m_node_ids[n], member.ref()) ||
+                           contains(m_previous_node_ids[n], member.ref());
+                case osmium::item_type::way:
+                    return contains(m_way_ids[n], member.ref()) ||
+                           contains(m_previous_way_ids[n], member.ref());
+                case osmium::item_type::relation:
+                    return contains(m_relation_ids[n], member.ref()) ||
+                           contains(m_previous_relation_ids[n],
+                                    member.ref());
+                default:
+                    break;
+                }
+                return false;
+            });
+    }
+    default:
+        break;
+    }
+
+    return false;
+}
+
+void RegionFilter::add_previous_version(osmium::OSMObject const &object)
+{
+    if (object.type() != osmium::item_type::node &&
+        object.type() != osmium::item_type::way &&
+        object.type() != osmium::item_type::relation) {
+        return;
+    }
+
+    for (std::size_t n = 0; n < m_boxes.size(); ++n) {
+        if (in_region(object, n)) {
+            add_id(previous_ids(object.type(), n), object.id());
+        }
+    }
+}
+
+void RegionFilter::find_regions(osmium::OSMObject const &object,
+                                std::vector<std::size_t> &result)
+{
+    result.clear();
+
+    if (object.type() != osmium::item_type::node &&
+        object.type() != osmium::item_type::way &&
+        object.type() != osmium::item_type::relation) {
+        return;
+    }
+
+    // An object is also in the regions an earlier version in the diff or
+    // its previous version was in.
+    for (std::size_t n = 0; n < m_boxes.size(); ++n) {
+        auto &seen = ids(object.type(), n);
+        if (in_region(object, n) || contains(seen, object.id()) ||
+            contains(previous_ids(object.type(), n), object.id())) {
+            add_id(seen, object.id());
+            result.push_back(n);
+        }
+    }
+}
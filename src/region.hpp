@@ -0,0 +1,66 @@
+#pragma once
+
+#include "config.hpp"
+
+#include <osmium/osm/object.hpp>
+#include <osmium/osm/types.hpp>
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Decides which regions the objects in a diff belong to. Nodes belong to
+ * all regions containing their location. Ways belong to all regions
+ * containing the location of one of their nodes or containing one of
+ * their nodes seen before. Relations belong to all regions containing one
+ * of their members seen before. All objects also belong to the regions
+ * their previous versions were in, so deletions and objects leaving a
+ * region are in the region diffs, too.
+ *
+ * Objects must be given in the order of the diff: nodes, then ways, then
+ * relations, each sorted by id.
+ */
+class RegionFilter
+{
+public:
+    explicit RegionFilter(std::vector<region_config> const &regions);
+
+    std::size_t size() const noexcept { return m_boxes.size(); }
+
+    /**
+     * Find the regions the object belongs to and put their indexes into
+     * result (after clearing it).
+     */
+    void find_regions(osmium::OSMObject const &object,
+                      std::vector<std::size_t> &result);
+
+    /**
+     * Add the previous version of an object in the diff. Way node
+     * locations must have been set. Previous versions must be added
+     * before find_regions() is called, in the same order as the objects.
+     */
+    void add_previous_version(osmium::OSMObject const &object);
+
+private:
+    bool in_region(osmium::OSMObject const &object, std::size_t n) const;
+
+    std::vector<osmium::object_id_type> &ids(osmium::item_type type,
+                                             std::size_t n);
+
+    std::vector<osmium::object_id_type> &
+    previous_ids(osmium::item_type type, std::size_t n);
+
+    std::vector<osmium::Box> m_boxes;
+
+    // ids of objects seen per region, sorted because they are added in
+    // order
+    std::vector<std::vector<osmium::object_id_type>> m_node_ids;
+    std::vector<std::vector<osmium::object_id_type>> m_way_ids;
+    std::vector<std::vector<osmium::object_id_type>> m_relation_ids;
+
+    // ids of objects whose previous versions were in the region
+    std::vector<std::vector<osmium::object_id_type>> m_previous_node_ids;
+    std::vector<std::vector<osmium::object_id_type>> m_previous_way_ids;
+    std::vector<std::vector<osmium::object_id_type>> m_previous_relation_ids;
+
+}; // class RegionFilter
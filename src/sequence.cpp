@@ -0,0 +1,88 @@
+#include "sequence.hpp"
+
+#include "io.hpp"
+#include "util.hpp"
+
+#include <cstddef>
+#include <fstream>
+#include <stdexcept>
+
+std::string sequence_path(std::uint64_t sequence)
+{
+    if (sequence > 999999999) {
+        throw std::runtime_error{"Sequence number too large: " +
+                                 std::to_string(sequence)};
+    }
+
+    static char const digits[] = "0123456789";
+
+    std::string path{"000/000/000"};
+    for (std::size_t pos = path.size(); pos > 0 && sequence > 0;) {
+        --pos;
+        if (path[pos] == '/') {
+            continue;
+        }
+        path[pos] = digits[sequence % 10];
+        sequence /= 10;
+    }
+
+    return path;
+}
+
+std::string state_file_content(std::uint64_t sequence,
+                               osmium::Timestamp timestamp)
+{
+    std::string content{"sequenceNumber="};
+    content += std::to_string(sequence);
+    content += "\ntimestamp=";
+
+    // colons have to be escaped in Java properties files
+    for (char const c : timestamp.to_iso()) {
+        if (c == ':') {
+            content += '\\';
+        }
+        content += c;
+    }
+    content += '\n';
+
+    return content;
+}
+
+sequence_record read_sequence_record(std::string const &dir_name)
+{
+    sequence_record record;
+
+    std::string const file_name{dir_name + "/osmdbt-sequence"};
+    std::ifstream file{file_name};
+    if (!file.is_open()) {
+        return record;
+    }
+
+    if (!(file >> record.sequence)) {
+        throw std::runtime_error{"Invalid sequence file '" + file_name + "'"};
+    }
+
+    // files written by older versions only contain the sequence number
+    file >> record.log_file_name;
+
+    return record;
+}
+
+std::uint64_t read_sequence(std::string const &dir_name)
+{
+    return read_sequence_record(dir_name).sequence;
+}
+
+void write_sequence(std::string const &dir_name, std::uint64_t sequence,
+                    std::string const &log_file_name)
+{
+    write_data_to_file(std::to_string(sequence) + ' ' + log_file_name + '\n',
+                       dir_name, "/osmdbt-sequence");
+}
+
+void create_sequence_dirs(std::string const &dir_name, std::uint64_t sequence)
+{
+    auto const path = sequence_path(sequence);
+    create_dir(dir_name + "/" + path.substr(0, 3));
+    create_dir(dir_name + "/" + path.substr(0, 7));
+}
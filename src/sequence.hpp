@@ -0,0 +1,56 @@
+#pragma once
+
+#include <osmium/osm/timestamp.hpp>
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Return the path of the replication files for the specified sequence
+ * number relative to the replication directory without suffix, for
+ * instance "000/001/234" for sequence number 1234.
+ */
+std::string sequence_path(std::uint64_t sequence);
+
+/**
+ * Return the contents of a state file for the specified sequence number
+ * and timestamp in the format used by Osmosis (and expected by all the
+ * replication clients).
+ */
+std::string state_file_content(std::uint64_t sequence,
+                               osmium::Timestamp timestamp);
+
+/// The last sequence number used and the log file its diff was created from.
+struct sequence_record
+{
+    std::uint64_t sequence = 0;
+    std::string log_file_name;
+};
+
+/**
+ * Read the last sequence number used and the name of the log file it was
+ * used for from the file "osmdbt-sequence" in the specified directory.
+ * Returns sequence number 0 if the file doesn't exist. The log file name
+ * is empty if it isn't in the file.
+ */
+sequence_record read_sequence_record(std::string const &dir_name);
+
+/**
+ * Read the last sequence number used from the file "osmdbt-sequence" in
+ * the specified directory. Returns 0 if the file doesn't exist.
+ */
+std::uint64_t read_sequence(std::string const &dir_name);
+
+/**
+ * Atomically write the last sequence number used and the name of the log
+ * file it was used for to the file "osmdbt-sequence" in the specified
+ * directory.
+ */
+void write_sequence(std::string const &dir_name, std::uint64_t sequence,
+                    std::string const &log_file_name);
+
+/**
+ * Create the directories needed for the replication files with the
+ * specified sequence number in the replication directory.
+ */
+void create_sequence_dirs(std::string const &dir_name, std::uint64_t sequence);
@@ -0,0 +1,34 @@
+#include "timewindow.hpp"
+
+#include <algorithm>
+
+std::vector<time_window> split_time_range(osmium::Timestamp start,
+                                          osmium::Timestamp end,
+                                          std::time_t interval)
+{
+    if (interval == 0) {
+        return {time_window{start, end}};
+    }
+
+    bool const open_end = !end.valid();
+    std::time_t const end_time =
+        open_end ? std::time(nullptr) : std::time_t(end.seconds_since_epoch());
+
+    std::vector<time_window> windows;
+    for (std::time_t t = start.seconds_since_epoch(); t < end_time;
+         t += interval) {
+        windows.push_back(time_window{
+            osmium::Timestamp{t},
+            osmium::Timestamp{std::min(t + interval, end_time)}});
+    }
+
+    if (windows.empty()) {
+        return {time_window{start, end}};
+    }
+
+    if (open_end) {
+        windows.back().end = osmium::Timestamp{};
+    }
+
+    return windows;
+}
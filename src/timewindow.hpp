@@ -0,0 +1,22 @@
+#pragma once
+
+#include <osmium/osm/timestamp.hpp>
+
+#include <ctime>
+#include <vector>
+
+/// Time window [start, end). End can be invalid (no limit).
+struct time_window
+{
+    osmium::Timestamp start;
+    osmium::Timestamp end;
+};
+
+/**
+ * Split the time range into windows of the specified length (in seconds).
+ * If the interval is 0, there is only one window. If there is no end, the
+ * windows go up to the current time and the last one has no end.
+ */
+std::vector<time_window> split_time_range(osmium::Timestamp start,
+                                          osmium::Timestamp end,
+                                          std::time_t interval);
@@ -0,0 +1,126 @@
+
+#include "timings.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+constexpr std::size_t LatencyHistogram::sub_buckets;
+
+std::size_t LatencyHistogram::bucket_index(std::uint64_t value) noexcept
+{
+    if (value < sub_buckets) {
+        return value;
+    }
+
+    unsigned int msb = 63;
+    while (!(value & (1ULL << msb))) {
+        --msb;
+    }
+
+    unsigned int const shift = msb - sub_bucket_bits;
+    return ((shift + 1) << sub_bucket_bits) +
+           ((value >> shift) & (sub_buckets - 1));
+}
+
+std::uint64_t LatencyHistogram::bucket_upper_bound(std::size_t index) noexcept
+{
+    if (index < sub_buckets) {
+        return index;
+    }
+
+    unsigned int const shift = (index >> sub_bucket_bits) - 1;
+    std::uint64_t const lower = (sub_buckets + (index & (sub_buckets - 1)))
+                                << shift;
+    return lower + ((1ULL << shift) - 1);
+}
+
+void LatencyHistogram::record(std::uint64_t value) noexcept
+{
+    ++m_buckets[bucket_index(value)];
+    ++m_count;
+    m_sum += value;
+    if (value > m_max) {
+        m_max = value;
+    }
+}
+
+std::uint64_t LatencyHistogram::quantile(double q) const noexcept
+{
+    if (m_count == 0) {
+        return 0;
+    }
+
+    auto const rank = static_cast<std::uint64_t>(q * m_count + 0.5);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < m_buckets.size(); ++i) {
+        seen += m_buckets[i];
+        if (seen > 0 && seen >= rank) {
+            return std::min(bucket_upper_bound(i), m_max);
+        }
+    }
+
+    return m_max;
+}
+
+void StatementTimings::record(char const *name, std::uint64_t nanoseconds)
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_histograms[name].record(nanoseconds);
+}
+
+static double to_ms(std::uint64_t nanoseconds) noexcept
+{
+    return static_cast<double>(nanoseconds) / 1000000.0;
+}
+
+void StatementTimings::print(osmium::VerboseOutput &vout) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    vout << "Statement timings (ms):\n";
+    vout << "  statement           count      total     mean      p50      "
+            "p90      p99      max\n";
+    for (auto const &h : m_histograms) {
+        char line[160];
+        auto const &hist = h.second;
+        std::snprintf(line, sizeof(line),
+                      "  %-15s %9llu %10.1f %8.3f %8.3f %8.3f %8.3f %8.3f\n",
+                      h.first.c_str(),
+                      static_cast<unsigned long long>(hist.count()),
+                      to_ms(hist.sum()), to_ms(hist.sum()) / hist.count(),
+                      to_ms(hist.quantile(0.5)), to_ms(hist.quantile(0.9)),
+                      to_ms(hist.quantile(0.99)), to_ms(hist.max()));
+        vout << line;
+    }
+}
+
+void StatementTimings::add_metrics(Metrics &metrics) const
+{
+    std::lock_guard<std::mutex> lock{m_mutex};
+
+    if (m_histograms.empty()) {
+        return;
+    }
+
+    char const *const name = "osmdbt_statement_duration_seconds";
+    metrics.describe(name, "Latency of database statements.", "summary");
+    for (auto const &h : m_histograms) {
+        auto const label = metrics_label("statement", h.first);
+        for (double const q : {0.5, 0.9, 0.99, 1.0}) {
+            char qs[8];
+            std::snprintf(qs, sizeof(qs), "%g", q);
+            metrics.add(name, h.second.quantile(q) / 1e9,
+                        label + "," + metrics_label("quantile", qs));
+        }
+        metrics.add("osmdbt_statement_duration_seconds_sum",
+                    h.second.sum() / 1e9, label);
+        metrics.add("osmdbt_statement_duration_seconds_count",
+                    static_cast<double>(h.second.count()), label);
+    }
+}
+
+StatementTimings &statement_timings()
+{
+    static StatementTimings timings;
+    return timings;
+}
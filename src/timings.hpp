@@ -0,0 +1,104 @@
+#pragma once
+
+#include "metrics.hpp"
+
+#include <osmium/util/verbose_output.hpp>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+/**
+ * Histogram of latencies in nanoseconds. Uses logarithmic buckets with each
+ * power of two split into 8 linear sub-buckets (like HDR histograms), so the
+ * relative error of reported values is at most 12.5%. Recording a value is
+ * just a few integer operations.
+ */
+class LatencyHistogram
+{
+public:
+    void record(std::uint64_t value) noexcept;
+
+    std::uint64_t count() const noexcept { return m_count; }
+    std::uint64_t sum() const noexcept { return m_sum; }
+    std::uint64_t max() const noexcept { return m_max; }
+
+    /// Return (an upper bound of) the value at the given quantile (0..1).
+    std::uint64_t quantile(double q) const noexcept;
+
+    static std::size_t bucket_index(std::uint64_t value) noexcept;
+    static std::uint64_t bucket_upper_bound(std::size_t index) noexcept;
+
+private:
+    static constexpr unsigned int sub_bucket_bits = 3;
+    static constexpr std::size_t sub_buckets = 1U << sub_bucket_bits;
+
+    std::array<std::uint64_t, 64 * sub_buckets> m_buckets{};
+    std::uint64_t m_count = 0;
+    std::uint64_t m_sum = 0;
+    std::uint64_t m_max = 0;
+}; // class LatencyHistogram
+
+/**
+ * Latency histograms for database statements by statement name. Recording
+ * is disabled by default, in which case StatementTimer does nothing.
+ */
+class StatementTimings
+{
+public:
+    bool enabled() const noexcept { return m_enabled; }
+    void enable() noexcept { m_enabled = true; }
+
+    void record(char const *name, std::uint64_t nanoseconds);
+
+    void print(osmium::VerboseOutput &vout) const;
+    void add_metrics(Metrics &metrics) const;
+
+private:
+    std::map<std::string, LatencyHistogram> m_histograms;
+    mutable std::mutex m_mutex;
+    bool m_enabled = false;
+}; // class StatementTimings
+
+/// The statement timings for this process.
+StatementTimings &statement_timings();
+
+/**
+ * Measures the time between construction and destruction and records it
+ * for the named statement if statement timings are enabled.
+ */
+class StatementTimer
+{
+public:
+    explicit StatementTimer(char const *name) : m_name(name)
+    {
+        if (statement_timings().enabled()) {
+            m_start = std::chrono::steady_clock::now();
+        } else {
+            m_name = nullptr;
+        }
+    }
+
+    StatementTimer(StatementTimer const &) = delete;
+    StatementTimer &operator=(StatementTimer const &) = delete;
+    StatementTimer(StatementTimer &&) = delete;
+    StatementTimer &operator=(StatementTimer &&) = delete;
+
+    ~StatementTimer()
+    {
+        if (m_name) {
+            auto const duration = std::chrono::steady_clock::now() - m_start;
+            statement_timings().record(
+                m_name,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+                    .count());
+        }
+    }
+
+private:
+    char const *m_name;
+    std::chrono::steady_clock::time_point m_start{};
+}; // class StatementTimer
@@ -2,9 +2,11 @@
 #include "util.hpp"
 #include "io.hpp"
 
-#include <osmium/io/detail/read_write.hpp>
 #include <osmium/osm/timestamp.hpp>
 
+#include <cstdlib>
+#include <cstring>
+
 /**
  * Replace a suffix (anything after last dot) on filename by the new_suffix.
  * If there is no suffix, append the new one. The new_suffix must begin with
@@ -50,19 +52,52 @@ std::string create_replication_log_name(std::string const &name, std::time_t tim
     return file_name;
 }
 
-void write_data_to_file(std::string const &data, std::string const &dir_name,
-                        std::string const &file_name)
+/**
+ * Is this the name of a log file as created by create_replication_log_name()?
+ */
+bool is_log_file_name(std::string const &file_name)
+{
+    static std::string const prefix{"osm-repl-"};
+    static std::string const suffix{".log"};
+
+    return file_name.size() > prefix.size() + suffix.size() &&
+           file_name.compare(0, prefix.size(), prefix) == 0 &&
+           file_name.compare(file_name.size() - suffix.size(), suffix.size(),
+                             suffix) == 0;
+}
+
+/**
+ * Get the LSN from the name of a log file created by osmdbt-get-log
+ * ("...-lsn-X-Y.log"). Returns 0 if there is no LSN in the name.
+ */
+std::uint64_t lsn_from_log_file_name(std::string const &file_name)
 {
-    std::string const file_name_final{dir_name + file_name};
-    std::string const file_name_new{file_name_final + ".new"};
+    auto const pos = file_name.rfind("-lsn-");
+    if (pos == std::string::npos) {
+        return 0;
+    }
+
+    char const *str = file_name.c_str() + pos + 5;
+    char *end = nullptr;
+    auto const high = std::strtoull(str, &end, 16);
+    if (end == str || *end != '-') {
+        return 0;
+    }
 
-    int const fd = osmium::io::detail::open_for_writing(
-        file_name_new, osmium::io::overwrite::no);
+    str = end + 1;
+    auto const low = std::strtoull(str, &end, 16);
+    if (end == str || std::strcmp(end, ".log") != 0) {
+        return 0;
+    }
 
-    osmium::io::detail::reliable_write(fd, data.data(), data.size());
-    osmium::io::detail::reliable_fsync(fd);
-    osmium::io::detail::reliable_close(fd);
+    return (static_cast<std::uint64_t>(high) << 32U) |
+           static_cast<std::uint64_t>(low);
+}
 
-    rename_file(file_name_new, file_name_final);
-    sync_dir(dir_name);
+void write_data_to_file(std::string const &data, std::string const &dir_name,
+                        std::string const &file_name)
+{
+    DurableWriter writer;
+    writer.add_data(dir_name + file_name, data);
+    writer.commit();
 }
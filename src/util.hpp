@@ -7,6 +7,7 @@
 
 #include <boost/program_options.hpp>
 
+#include <cstdint>
 #include <ctime>
 #include <string>
 
@@ -15,6 +16,8 @@ std::string dirname(std::string file_name);
 std::string get_time(std::time_t now);
 std::string create_replication_log_name(std::string const &name,
                                         std::time_t time = std::time(nullptr));
+bool is_log_file_name(std::string const &file_name);
+std::uint64_t lsn_from_log_file_name(std::string const &file_name);
 void write_data_to_file(std::string const &data, std::string const &dir_name,
                         std::string const &file_name);
 
@@ -0,0 +1,22 @@
+#!/bin/sh
+
+set -e
+
+zgrep 'node id="10" version="1"' osm-repl.osh.gz
+zgrep 'node id="11" version="1"' osm-repl.osh.gz
+zgrep 'way id="20" version="1"' osm-repl.osh.gz
+
+# The previous version of a changed node comes before the new version.
+zcat versions-last.osh.gz >versions-last.osh
+
+v2=`grep -n 'node id="30" version="2"' versions-last.osh | cut -d: -f1`
+v3=`grep -n 'node id="30" version="3"' versions-last.osh | cut -d: -f1`
+test -n "$v2"
+test -n "$v3"
+test "$v2" -lt "$v3"
+
+if grep 'node id="30" version="1"' versions-last.osh; then
+    exit 1
+fi
+
+rm -f versions-last.osh
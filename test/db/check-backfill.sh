@@ -0,0 +1,12 @@
+#!/bin/sh
+
+set -e
+
+for log in osm-repl-*.log; do
+    test -f ${log%.log}.osc.gz
+    test ! -f ${log%.log}.osc.gz.new
+done
+
+zgrep 'node id="10" version="1"' osm-repl-*-lsn-*.osc.gz
+zgrep 'node id="11" version="1"' osm-repl-*-lsn-*.osc.gz
+zgrep 'way id="20" version="1"' osm-repl-*-lsn-*.osc.gz
@@ -0,0 +1,19 @@
+#!/bin/sh
+
+set -e
+
+grep '^n10 v1 dV c1 t2020-02-20T20:20:20Z i1 utestuser T x2 y1$' current.osm.opl
+grep '^n11 v1 dV c1 t2020-02-20T20:20:20Z i1 utestuser T x2.1 y1.1$' current.osm.opl
+grep '^w20 v1 dV c1 t2020-02-20T20:20:20Z i1 utestuser Thighway=primary,name=High%20%Street Nn10,n11$' current.osm.opl
+grep '^lsn=' current.state.txt
+
+# no sequence number without --create-slot
+if grep '^sequenceNumber=' current.state.txt; then
+    exit 1
+fi
+
+if grep '^n12 ' current.osm.opl; then
+    exit 1
+fi
+
+rm -f current.osm.opl current.state.txt
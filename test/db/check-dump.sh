@@ -0,0 +1,17 @@
+#!/bin/sh
+
+set -e
+
+cat dump-000.osh.opl dump-001.osh.opl >dump.osh.opl
+
+grep '^n10 v1 dV c1 t2020-02-20T20:20:20Z i1 utestuser T x2 y1$' dump.osh.opl
+grep '^n11 v1 dV c1 t2020-02-20T20:20:20Z i1 utestuser T x2.1 y1.1$' dump.osh.opl
+grep '^w20 v1 dV c1 t2020-02-20T20:20:20Z i1 utestuser Thighway=primary,name=High%20%Street Nn10,n11$' dump.osh.opl
+grep '^lsn=' dump.state.txt
+
+# no sequence number without --create-slot
+if grep '^sequenceNumber=' dump.state.txt; then
+    exit 1
+fi
+
+rm -f dump*.osh.opl dump.state.txt
@@ -0,0 +1,6 @@
+#!/bin/sh
+
+set -e
+
+# The tile of the previous version of the node is expired, too.
+printf '1/1/0\n12/2093/2036\n12/2104/2036\n' | diff - versions-last.tiles
@@ -0,0 +1,5 @@
+#!/bin/sh
+
+set -e
+
+printf '1/1/0\n12/2070/2036\n12/2071/2035\n' | diff - osm-repl.tiles
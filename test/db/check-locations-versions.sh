@@ -0,0 +1,8 @@
+#!/bin/sh
+
+set -e
+
+# The nodes are a fraction of a second older than the way, but in the same
+# second.
+zgrep '<nd ref="40" .*lat="1"' versions-way.osc.gz
+zgrep '<nd ref="41" .*lat="1.1"' versions-way.osc.gz
@@ -0,0 +1,6 @@
+#!/bin/sh
+
+set -e
+
+zgrep '<nd ref="10" .*lat="1"' osm-repl.osc.gz
+zgrep '<nd ref="11" .*lat="1.1"' osm-repl.osc.gz
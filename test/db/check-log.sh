@@ -7,7 +7,8 @@ grep ' n11 v1 c1$' osm-repl-*.log
 grep ' w20 v1 c1$' osm-repl-*.log
 
 # Remove files left over from previous runs
-rm -f osm-repl.log osm-repl.osc.gz osm-repl.osc.gz.new
+rm -f osm-repl.log osm-repl.osc.gz osm-repl.osc.gz.new osm-repl.osh.gz osm-repl.tiles
+rm -rf 000 state.txt osmdbt-sequence inside outside
 
 # Make the replication log available under a static name
 ln -s osm-repl-*-lsn-*.log osm-repl.log
@@ -0,0 +1,15 @@
+#!/bin/sh
+
+set -e
+
+# In --sequence mode the last sequence number is written instead of the
+# number of change files.
+$1 -c test-config.yaml -q >monitor.prom
+
+grep '^osmdbt_sequence_number 1$' monitor.prom
+
+if grep '^osmdbt_diff_files ' monitor.prom; then
+    exit 1
+fi
+
+rm -f monitor.prom
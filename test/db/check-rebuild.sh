@@ -0,0 +1,14 @@
+#!/bin/sh
+
+set -e
+
+zgrep 'node id="10" version="1"' 000/000/100.osc.gz
+zgrep 'node id="11" version="1"' 000/000/100.osc.gz
+zgrep 'way id="20" version="1"' 000/000/100.osc.gz
+grep '^sequenceNumber=100$' 000/000/100.state.txt
+grep '^timestamp=2020-02-20T20\\:30\\:00Z$' 000/000/100.state.txt
+
+if zgrep 'id=' 000/000/101.osc.gz; then
+    exit 1
+fi
+grep '^timestamp=2020-02-20T21\\:00\\:00Z$' 000/000/101.state.txt
@@ -0,0 +1,18 @@
+#!/bin/sh
+
+set -e
+
+zgrep 'node id="10" version="1"' inside/osm-repl.osc.gz
+zgrep 'node id="11" version="1"' inside/osm-repl.osc.gz
+zgrep 'way id="20" version="1"' inside/osm-repl.osc.gz
+
+if zgrep 'id=' outside/osm-repl.osc.gz; then
+    exit 1
+fi
+
+# The deleted way is in the region its previous version was in.
+zgrep 'way id="60" version="2"' inside/versions-deleted.osc.gz
+
+if zgrep 'id=' outside/versions-deleted.osc.gz; then
+    exit 1
+fi
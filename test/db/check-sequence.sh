@@ -0,0 +1,14 @@
+#!/bin/sh
+
+set -e
+
+zgrep 'node id="10" version="1"' 000/000/001.osc.gz
+grep '^sequenceNumber=1$' 000/000/001.state.txt
+grep '^sequenceNumber=1$' state.txt
+grep '^1 osm-repl.log$' osmdbt-sequence
+
+# Running again on the same log file must not publish it again under a new
+# sequence number.
+if [ -e 000/000/002.osc.gz ]; then
+    exit 1
+fi
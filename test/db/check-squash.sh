@@ -0,0 +1,11 @@
+#!/bin/sh
+
+set -e
+
+# Version 1 marks the node as created, version 2 is squashed away.
+zgrep 'node id="30" version="1"' versions-all.osc.gz
+zgrep 'node id="30" version="3" timestamp="2020-02-21T10:00:02Z"' versions-all.osc.gz
+
+if zgrep 'node id="30" version="2"' versions-all.osc.gz; then
+    exit 1
+fi
@@ -0,0 +1,27 @@
+#!/bin/sh
+
+set -e
+
+psql <<"EOF"
+
+BEGIN;
+
+INSERT INTO current_nodes (id, latitude, longitude, changeset_id, visible, "timestamp", tile, version)
+    VALUES (10, 10000000, 20000000, 1, true, '2020-02-20T20:20:20Z', 0, 1),
+           (11, 11000000, 21000000, 1, true, '2020-02-20T20:20:20Z', 0, 1),
+           (12, 12000000, 22000000, 1, false, '2020-02-20T20:20:20Z', 0, 2);
+
+INSERT INTO current_ways (id, changeset_id, visible, "timestamp", version)
+    VALUES (20, 1, true, '2020-02-20T20:20:20Z', 1);
+
+INSERT INTO current_way_nodes (way_id, sequence_id, node_id)
+    VALUES (20, 0, 10),
+           (20, 1, 11);
+
+INSERT INTO current_way_tags (way_id, k, v)
+    VALUES (20, 'highway', 'primary'),
+           (20, 'name', 'High Street');
+
+COMMIT;
+
+EOF
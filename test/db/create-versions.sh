@@ -0,0 +1,70 @@
+#!/bin/sh
+
+set -e
+
+# Remove files from previous runs
+rm -f versions-*
+
+psql <<"EOF2"
+
+BEGIN;
+
+-- A node moved twice
+INSERT INTO nodes (node_id, latitude, longitude, changeset_id, visible, "timestamp", tile, version)
+    VALUES (30, 10000000, 30000000, 1, true, '2020-02-21T10:00:00Z', 0, 1),
+           (30, 10000000, 40000000, 1, true, '2020-02-21T10:00:01Z', 0, 2),
+           (30, 10000000, 50000000, 1, true, '2020-02-21T10:00:02.7Z', 0, 3);
+
+-- A way created a fraction of a second after its nodes
+INSERT INTO nodes (node_id, latitude, longitude, changeset_id, visible, "timestamp", tile, version)
+    VALUES (40, 10000000, 60000000, 1, true, '2020-02-21T11:00:00.2Z', 0, 1),
+           (41, 11000000, 61000000, 1, true, '2020-02-21T11:00:00.3Z', 0, 1);
+
+INSERT INTO ways (way_id, changeset_id, visible, "timestamp", version)
+    VALUES (50, 1, true, '2020-02-21T11:00:00.6Z', 1);
+
+INSERT INTO way_nodes (way_id, version, sequence_id, node_id)
+    VALUES (50, 1, 0, 40),
+           (50, 1, 1, 41);
+
+-- A way in the "inside" region, deleted in version 2
+INSERT INTO ways (way_id, changeset_id, visible, "timestamp", version)
+    VALUES (60, 1, true, '2020-02-21T12:00:00Z', 1),
+           (60, 1, false, '2020-02-21T12:00:01Z', 2);
+
+INSERT INTO way_nodes (way_id, version, sequence_id, node_id)
+    VALUES (60, 1, 0, 10),
+           (60, 1, 1, 11);
+
+COMMIT;
+
+EOF2
+
+# Log files with only the last version and with all versions of the node
+cat >versions-last.log <<"EOF2"
+1/A 1000 B
+1/B 1000 N n30 v3 c1
+1/C 1000 C
+EOF2
+
+cat >versions-all.log <<"EOF2"
+1/A 1000 B
+1/B 1000 N n30 v1 c1
+1/C 1000 N n30 v2 c1
+1/D 1000 N n30 v3 c1
+1/E 1000 C
+EOF2
+
+cat >versions-way.log <<"EOF2"
+1/A 1000 B
+1/B 1000 N n40 v1 c1
+1/C 1000 N n41 v1 c1
+1/D 1000 N w50 v1 c1
+1/E 1000 C
+EOF2
+
+cat >versions-deleted.log <<"EOF2"
+1/A 1000 B
+1/B 1000 N w60 v2 c1
+1/C 1000 C
+EOF2
@@ -28,6 +28,11 @@ database:
 log_dir: $TESTDIR
 changes_dir: $TESTDIR
 run_dir: $TESTDIR
+regions:
+    - name: inside
+      bbox: [1.5, 0.5, 2.5, 1.5]
+    - name: outside
+      bbox: [-10.0, -10.0, -5.0, -5.0]
 EOF
 
 psql <$SRCDIR/../../structure.sql
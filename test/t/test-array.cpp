@@ -0,0 +1,75 @@
+
+#include <catch.hpp>
+
+#include "array.hpp"
+#include "exception.hpp"
+
+TEST_CASE("empty and NULL arrays")
+{
+    std::string value;
+
+    ArrayReader empty{"{}"};
+    REQUIRE(empty.at_end());
+    REQUIRE_FALSE(empty.next(value));
+
+    ArrayReader null{""};
+    REQUIRE(null.at_end());
+    REQUIRE_FALSE(null.next(value));
+}
+
+TEST_CASE("integer array")
+{
+    ArrayReader reader{"{1,-22,333,8000000000}"};
+    std::int64_t value = 0;
+
+    REQUIRE(reader.next_int(value));
+    REQUIRE(value == 1);
+    REQUIRE(reader.next_int(value));
+    REQUIRE(value == -22);
+    REQUIRE(reader.next_int(value));
+    REQUIRE(value == 333);
+    REQUIRE(reader.next_int(value));
+    REQUIRE(value == 8000000000);
+    REQUIRE(reader.at_end());
+    REQUIRE_FALSE(reader.next_int(value));
+}
+
+TEST_CASE("string array with quoting")
+{
+    ArrayReader reader{R"({outer,"","a b","x,y","q\"q","b\\s",NULL})"};
+    std::string value;
+
+    REQUIRE(reader.next(value));
+    REQUIRE(value == "outer");
+    REQUIRE(reader.next(value));
+    REQUIRE(value.empty());
+    REQUIRE(reader.next(value));
+    REQUIRE(value == "a b");
+    REQUIRE(reader.next(value));
+    REQUIRE(value == "x,y");
+    REQUIRE(reader.next(value));
+    REQUIRE(value == "q\"q");
+    REQUIRE(reader.next(value));
+    REQUIRE(value == "b\\s");
+    REQUIRE(reader.next(value));
+    REQUIRE(value == "NULL");
+    REQUIRE_FALSE(reader.next(value));
+}
+
+TEST_CASE("invalid arrays")
+{
+    std::string value;
+    std::int64_t ivalue = 0;
+
+    REQUIRE_THROWS_AS(ArrayReader{"1,2"}, database_error);
+
+    ArrayReader unterminated{"{1,2"};
+    REQUIRE(unterminated.next_int(ivalue));
+    REQUIRE_THROWS_AS(unterminated.next_int(ivalue), database_error);
+
+    ArrayReader not_int{"{a}"};
+    REQUIRE_THROWS_AS(not_int.next_int(ivalue), database_error);
+
+    ArrayReader unterminated_string{"{\"abc}"};
+    REQUIRE_THROWS_AS(unterminated_string.next(value), database_error);
+}
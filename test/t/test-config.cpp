@@ -21,6 +21,7 @@ TEST_CASE("empty config file")
     REQUIRE(config.log_dir() == "/tmp");
     REQUIRE(config.changes_dir() == "/tmp");
     REQUIRE(config.run_dir() == "/tmp");
+    REQUIRE(config.metrics_dir().empty());
 }
 
 TEST_CASE("default config file")
@@ -34,6 +35,7 @@ TEST_CASE("default config file")
     REQUIRE(config.log_dir() == "/tmp");
     REQUIRE(config.changes_dir() == "/tmp");
     REQUIRE(config.run_dir() == "/tmp");
+    REQUIRE(config.metrics_dir().empty());
 }
 
 TEST_CASE("invalid database section")
@@ -51,3 +53,24 @@ TEST_CASE("invalid yaml")
     REQUIRE_THROWS_AS(Config("test/t/test-config-invalid-yaml.yaml", vout),
                       YAML::Exception);
 }
+
+TEST_CASE("regions")
+{
+    osmium::VerboseOutput vout{false};
+    Config config{"test/t/test-config-regions.yaml", vout};
+
+    REQUIRE(config.regions().size() == 2);
+    REQUIRE(config.regions()[0].name == "west");
+    REQUIRE(config.regions()[1].name == "east");
+    REQUIRE(config.regions()[1].box.bottom_left() ==
+            osmium::Location{10.0, 0.0});
+    REQUIRE(config.regions()[1].box.top_right() ==
+            osmium::Location{20.0, 10.0});
+}
+
+TEST_CASE("invalid region")
+{
+    osmium::VerboseOutput vout{false};
+    REQUIRE_THROWS_WITH(Config("test/t/test-config-invalid-region.yaml", vout),
+                        "Config error: Region 'broken' has invalid 'bbox'.");
+}
@@ -0,0 +1,65 @@
+#include <catch.hpp>
+
+#include "exception.hpp"
+#include "expire.hpp"
+
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/memory/buffer.hpp>
+
+#include <vector>
+
+TEST_CASE("parse zoom levels")
+{
+    REQUIRE(parse_zoom_levels("12") == std::vector<uint32_t>{12});
+    REQUIRE(parse_zoom_levels("14,12") == std::vector<uint32_t>{12, 14});
+    REQUIRE(parse_zoom_levels("10-12,16,11") ==
+            std::vector<uint32_t>{10, 11, 12, 16});
+    REQUIRE(parse_zoom_levels("0-0") == std::vector<uint32_t>{0});
+}
+
+TEST_CASE("parse invalid zoom levels")
+{
+    REQUIRE_THROWS_AS(parse_zoom_levels(""), argument_error);
+    REQUIRE_THROWS_AS(parse_zoom_levels("12,"), argument_error);
+    REQUIRE_THROWS_AS(parse_zoom_levels("x"), argument_error);
+    REQUIRE_THROWS_AS(parse_zoom_levels("21"), argument_error);
+    REQUIRE_THROWS_AS(parse_zoom_levels("14-12"), argument_error);
+    REQUIRE_THROWS_AS(parse_zoom_levels("-12"), argument_error);
+}
+
+TEST_CASE("expire locations")
+{
+    TileExpiry expiry{{1, 12}};
+
+    expiry.add_location(osmium::Location{2.0, 1.0});
+    expiry.add_location(osmium::Location{2.1, 1.1});
+    expiry.add_location(osmium::Location{2.0, 1.0});
+    expiry.add_location(osmium::Location{});
+
+    REQUIRE(expiry.list() == "1/1/0\n12/2070/2036\n12/2071/2035\n");
+}
+
+TEST_CASE("expire nothing")
+{
+    TileExpiry expiry{{12}};
+    REQUIRE(expiry.list().empty());
+}
+
+TEST_CASE("expire way nodes")
+{
+    osmium::memory::Buffer buffer{1024};
+    {
+        osmium::builder::WayBuilder builder{buffer};
+        builder.set_id(20);
+        osmium::builder::WayNodeListBuilder wnbuilder{builder};
+        wnbuilder.add_node_ref(10, osmium::Location{0.5, 0.5});
+        wnbuilder.add_node_ref(11, osmium::Location{-0.5, -0.5});
+        wnbuilder.add_node_ref(12);
+    }
+    auto const &way = buffer.get<osmium::Way>(buffer.commit());
+
+    TileExpiry expiry{{0, 1}};
+    expiry.add_object(way);
+
+    REQUIRE(expiry.list() == "0/0/0\n1/0/1\n1/1/0\n");
+}
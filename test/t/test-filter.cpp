@@ -0,0 +1,40 @@
+#include <catch.hpp>
+
+#include "filter.hpp"
+
+#include <vector>
+
+TEST_CASE("sort_unique")
+{
+    std::vector<id_version_type> list{{3, 1}, {1, 2}, {3, 1}, {1, 1}};
+    sort_unique(list);
+
+    REQUIRE(list.size() == 3);
+    REQUIRE(list[0] == id_version_type{1, 1});
+    REQUIRE(list[1] == id_version_type{1, 2});
+    REQUIRE(list[2] == id_version_type{3, 1});
+}
+
+TEST_CASE("empty filter")
+{
+    std::vector<id_version_type> const list;
+    IdFilter filter{list};
+
+    REQUIRE_FALSE(filter.contains({1, 1}));
+    REQUIRE_FALSE(filter.contains({2, 1}));
+}
+
+TEST_CASE("filter")
+{
+    std::vector<id_version_type> const list{{2, 1}, {2, 3}, {5, 1}};
+    IdFilter filter{list};
+
+    REQUIRE_FALSE(filter.contains({1, 1}));
+    REQUIRE(filter.contains({2, 1}));
+    REQUIRE_FALSE(filter.contains({2, 2}));
+    REQUIRE(filter.contains({2, 3}));
+    REQUIRE_FALSE(filter.contains({4, 1}));
+    REQUIRE(filter.contains({5, 1}));
+    REQUIRE_FALSE(filter.contains({5, 2}));
+    REQUIRE_FALSE(filter.contains({7, 1}));
+}
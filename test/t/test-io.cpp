@@ -0,0 +1,95 @@
+#include <catch.hpp>
+
+#include "io.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include <unistd.h>
+
+static std::string read_file(std::string const &file_name)
+{
+    std::ifstream file{file_name};
+    return std::string{std::istreambuf_iterator<char>{file},
+                       std::istreambuf_iterator<char>{}};
+}
+
+static std::string make_temp_dir()
+{
+    char dir_name[] = "/tmp/osmdbt-test-XXXXXX";
+    REQUIRE(::mkdtemp(dir_name) != nullptr);
+    return dir_name;
+}
+
+TEST_CASE("DurableWriter publishes files on commit")
+{
+    auto const dir = make_temp_dir();
+
+    DurableWriter writer;
+    writer.add_data(dir + "/a", "foo\n");
+    writer.add_data(dir + "/b", "bar\n");
+    REQUIRE_FALSE(file_exists(dir + "/a"));
+    REQUIRE_FALSE(file_exists(dir + "/b"));
+
+    writer.commit();
+    REQUIRE(read_file(dir + "/a") == "foo\n");
+    REQUIRE(read_file(dir + "/b") == "bar\n");
+    REQUIRE(list_dir(dir).size() == 2);
+    REQUIRE(writer.file_syncs() == 2);
+    REQUIRE(writer.dir_syncs() == 1);
+
+    std::remove((dir + "/a").c_str());
+    std::remove((dir + "/b").c_str());
+    ::rmdir(dir.c_str());
+}
+
+TEST_CASE("DurableWriter replaces existing files")
+{
+    auto const dir = make_temp_dir();
+
+    DurableWriter writer;
+    writer.add_data(dir + "/state.txt", "1\n");
+    writer.commit();
+    writer.add_data(dir + "/state.txt", "2\n");
+    writer.commit();
+    REQUIRE(read_file(dir + "/state.txt") == "2\n");
+    REQUIRE(list_dir(dir).size() == 1);
+
+    std::remove((dir + "/state.txt").c_str());
+    ::rmdir(dir.c_str());
+}
+
+TEST_CASE("DurableWriter publishes already written files")
+{
+    auto const dir = make_temp_dir();
+
+    {
+        std::ofstream file{dir + "/x.new"};
+        file << "x\n";
+    }
+
+    DurableWriter writer;
+    writer.add_file(dir + "/x.new", dir + "/x");
+    writer.commit();
+    REQUIRE(read_file(dir + "/x") == "x\n");
+    REQUIRE_FALSE(file_exists(dir + "/x.new"));
+
+    std::remove((dir + "/x").c_str());
+    ::rmdir(dir.c_str());
+}
+
+TEST_CASE("DurableWriter doesn't leave files without commit")
+{
+    auto const dir = make_temp_dir();
+
+    {
+        DurableWriter writer;
+        writer.add_data(dir + "/a", "foo\n");
+    }
+    REQUIRE(list_dir(dir).empty());
+
+    ::rmdir(dir.c_str());
+}
@@ -0,0 +1,30 @@
+
+#include <catch.hpp>
+
+#include "metrics.hpp"
+
+TEST_CASE("metrics_label")
+{
+    REQUIRE(metrics_label("slot", "rs") == "slot=\"rs\"");
+    REQUIRE(metrics_label("x", "a\"b\\c\nd") == "x=\"a\\\"b\\\\c\\nd\"");
+}
+
+TEST_CASE("gauge metrics")
+{
+    Metrics metrics;
+    metrics.gauge("foo", "Some help.", 42);
+    metrics.add("foo", 0.5, metrics_label("a", "b"));
+
+    REQUIRE(metrics.data() == "# HELP foo Some help.\n"
+                              "# TYPE foo gauge\n"
+                              "foo 42\n"
+                              "foo{a=\"b\"} 0.5\n");
+}
+
+TEST_CASE("large values are written exactly")
+{
+    Metrics metrics;
+    metrics.add("bar", 123456789012.0);
+
+    REQUIRE(metrics.data() == "bar 123456789012\n");
+}
@@ -94,3 +94,59 @@ TEST_CASE("parser error")
     REQUIRE_THROWS(osmobj("n123", "v3", "c"));
     REQUIRE_THROWS(osmobj("n123", "v3", ""));
 }
+
+TEST_CASE("squash versions")
+{
+    std::vector<osmobj> o{
+        osmobj{"n1", "v1", "c1"}, // created and modified
+        osmobj{"n1", "v2", "c2"},
+        osmobj{"n1", "v3", "c3"},
+        osmobj{"n2", "v1", "c1"}, // created and deleted
+        osmobj{"n2", "v2", "c2"},
+        osmobj{"n3", "v4", "c1"}, // modified
+        osmobj{"n3", "v5", "c2"},
+        osmobj{"n4", "v1", "c1"}, // created
+        osmobj{"w1", "v7", "c3"}  // modified
+    };
+
+    auto const created = created_objects(o);
+    REQUIRE(created.size() == 2);
+    REQUIRE(created[0].id() == 1);
+    REQUIRE(created[0].version() == 3);
+    REQUIRE(created[1].id() == 2);
+    REQUIRE(created[1].version() == 2);
+
+    std::vector<osmobj> const deleted{created[1]};
+    auto const squashed = squash_versions(o, deleted);
+
+    REQUIRE(squashed.size() == 5);
+    REQUIRE(squashed[0].id() == 1);
+    REQUIRE(squashed[0].version() == 1);
+    REQUIRE(squashed[1].id() == 1);
+    REQUIRE(squashed[1].version() == 3);
+    REQUIRE(squashed[1].cid() == 3);
+    REQUIRE(squashed[2].id() == 3);
+    REQUIRE(squashed[2].version() == 5);
+    REQUIRE(squashed[3].id() == 4);
+    REQUIRE(squashed[3].version() == 1);
+    REQUIRE(squashed[4].type() == osmium::item_type::way);
+    REQUIRE(squashed[4].version() == 7);
+}
+
+TEST_CASE("squash empty list")
+{
+    std::vector<osmobj> const o;
+    REQUIRE(created_objects(o).empty());
+    REQUIRE(squash_versions(o, o).empty());
+}
+
+TEST_CASE("current query")
+{
+    auto const query = current_query(osmium::item_type::way, "o.id = 1");
+    REQUIRE(query.find("FROM current_ways o") != std::string::npos);
+    REQUIRE(query.find("FROM current_way_tags WHERE way_id = o.id") !=
+            std::string::npos);
+    REQUIRE(query.find("FROM current_way_nodes WHERE way_id = o.id") !=
+            std::string::npos);
+    REQUIRE(query.find("version) =") == std::string::npos);
+}
@@ -0,0 +1,152 @@
+#include <catch.hpp>
+
+#include "region.hpp"
+
+#include <osmium/builder/osm_object_builder.hpp>
+#include <osmium/memory/buffer.hpp>
+
+#include <vector>
+
+static std::vector<region_config> test_regions()
+{
+    std::vector<region_config> regions(2);
+    regions[0].name = "west";
+    regions[0].box = osmium::Box{0.0, 0.0, 10.0, 10.0};
+    regions[1].name = "east";
+    regions[1].box = osmium::Box{10.0, 0.0, 20.0, 10.0};
+    return regions;
+}
+
+static osmium::Node const &add_node(osmium::memory::Buffer &buffer,
+                                    osmium::object_id_type id,
+                                    osmium::Location location)
+{
+    {
+        osmium::builder::NodeBuilder builder{buffer};
+        builder.set_id(id).set_location(location);
+    }
+    return buffer.get<osmium::Node>(buffer.commit());
+}
+
+static osmium::Way const &
+add_way(osmium::memory::Buffer &buffer, osmium::object_id_type id,
+        std::vector<osmium::object_id_type> const &node_ids,
+        osmium::Location location = osmium::Location{})
+{
+    {
+        osmium::builder::WayBuilder builder{buffer};
+        builder.set_id(id);
+        osmium::builder::WayNodeListBuilder wnbuilder{builder};
+        for (auto const node_id : node_ids) {
+            wnbuilder.add_node_ref(node_id, location);
+        }
+    }
+    return buffer.get<osmium::Way>(buffer.commit());
+}
+
+static osmium::Relation const &add_relation(osmium::memory::Buffer &buffer,
+                                            osmium::object_id_type id,
+                                            osmium::item_type type,
+                                            osmium::object_id_type member)
+{
+    {
+        osmium::builder::RelationBuilder builder{buffer};
+        builder.set_id(id);
+        osmium::builder::RelationMemberListBuilder mbuilder{builder};
+        mbuilder.add_member(type, member, "");
+    }
+    return buffer.get<osmium::Relation>(buffer.commit());
+}
+
+TEST_CASE("region filter")
+{
+    RegionFilter filter{test_regions()};
+    REQUIRE(filter.size() == 2);
+
+    osmium::memory::Buffer buffer{1024 * 1024};
+    std::vector<std::size_t> result;
+
+    filter.find_regions(add_node(buffer, 1, osmium::Location{5.0, 5.0}),
+                        result);
+    REQUIRE(result == std::vector<std::size_t>{0});
+
+    filter.find_regions(add_node(buffer, 2, osmium::Location{15.0, 5.0}),
+                        result);
+    REQUIRE(result == std::vector<std::size_t>{1});
+
+    filter.find_regions(add_node(buffer, 3, osmium::Location{50.0, 5.0}),
+                        result);
+    REQUIRE(result.empty());
+
+    // way with node seen before in the diff
+    filter.find_regions(add_way(buffer, 10, {1, 3}), result);
+    REQUIRE(result == std::vector<std::size_t>{0});
+
+    // way with node location
+    filter.find_regions(
+        add_way(buffer, 11, {4}, osmium::Location{15.0, 1.0}), result);
+    REQUIRE(result == std::vector<std::size_t>{1});
+
+    // way in both regions
+    filter.find_regions(add_way(buffer, 12, {1, 2}), result);
+    REQUIRE(result == std::vector<std::size_t>({0, 1}));
+
+    // way without known nodes or locations
+    filter.find_regions(add_way(buffer, 13, {5, 6}), result);
+    REQUIRE(result.empty());
+
+    filter.find_regions(
+        add_relation(buffer, 20, osmium::item_type::way, 11), result);
+    REQUIRE(result == std::vector<std::size_t>{1});
+
+    filter.find_regions(
+        add_relation(buffer, 21, osmium::item_type::relation, 20), result);
+    REQUIRE(result == std::vector<std::size_t>{1});
+
+    filter.find_regions(
+        add_relation(buffer, 22, osmium::item_type::node, 3), result);
+    REQUIRE(result.empty());
+}
+
+TEST_CASE("region filter with previous versions")
+{
+    RegionFilter filter{test_regions()};
+
+    osmium::memory::Buffer previous{1024 * 1024};
+    osmium::memory::Buffer buffer{1024 * 1024};
+    std::vector<std::size_t> result;
+
+    // node 1 was in "west" and moved to "east"
+    filter.add_previous_version(
+        add_node(previous, 1, osmium::Location{5.0, 5.0}));
+
+    // way 10 was in "west" and was deleted
+    filter.add_previous_version(
+        add_way(previous, 10, {7}, osmium::Location{5.0, 1.0}));
+
+    // relation 20 had way 10 as member and was deleted
+    filter.add_previous_version(
+        add_relation(previous, 20, osmium::item_type::way, 10));
+
+    filter.find_regions(add_node(buffer, 1, osmium::Location{15.0, 5.0}),
+                        result);
+    REQUIRE(result == std::vector<std::size_t>({0, 1}));
+
+    // a later version of the same node in the diff
+    filter.find_regions(add_node(buffer, 1, osmium::Location{15.0, 6.0}),
+                        result);
+    REQUIRE(result == std::vector<std::size_t>({0, 1}));
+
+    // deleted way without nodes
+    filter.find_regions(add_way(buffer, 10, {}), result);
+    REQUIRE(result == std::vector<std::size_t>{0});
+
+    // deleted relation without members
+    {
+        osmium::builder::RelationBuilder builder{buffer};
+        builder.set_id(20);
+    }
+    filter.find_regions(buffer.get<osmium::Relation>(buffer.commit()),
+                        result);
+    REQUIRE(result == std::vector<std::size_t>{0});
+}
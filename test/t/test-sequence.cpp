@@ -0,0 +1,56 @@
+#include <catch.hpp>
+
+#include "sequence.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+TEST_CASE("sequence_path")
+{
+    REQUIRE(sequence_path(0) == "000/000/000");
+    REQUIRE(sequence_path(7) == "000/000/007");
+    REQUIRE(sequence_path(1234) == "000/001/234");
+    REQUIRE(sequence_path(3912345) == "003/912/345");
+    REQUIRE(sequence_path(999999999) == "999/999/999");
+    REQUIRE_THROWS(sequence_path(1000000000));
+}
+
+TEST_CASE("state_file_content")
+{
+    osmium::Timestamp const ts{"2020-02-20T20:20:20Z"};
+    REQUIRE(state_file_content(1234, ts) ==
+            "sequenceNumber=1234\ntimestamp=2020-02-20T20\\:20\\:20Z\n");
+}
+
+TEST_CASE("read_sequence_record and write_sequence")
+{
+    char dir_name[] = "/tmp/osmdbt-test-XXXXXX";
+    REQUIRE(::mkdtemp(dir_name) != nullptr);
+    std::string const dir{dir_name};
+
+    auto record = read_sequence_record(dir);
+    REQUIRE(record.sequence == 0);
+    REQUIRE(record.log_file_name.empty());
+
+    write_sequence(dir, 17, "osm-repl-x.log");
+    record = read_sequence_record(dir);
+    REQUIRE(record.sequence == 17);
+    REQUIRE(record.log_file_name == "osm-repl-x.log");
+    REQUIRE(read_sequence(dir) == 17);
+
+    // files written by older versions only contain the sequence number
+    {
+        std::ofstream file{dir + "/osmdbt-sequence"};
+        file << "42\n";
+    }
+    record = read_sequence_record(dir);
+    REQUIRE(record.sequence == 42);
+    REQUIRE(record.log_file_name.empty());
+
+    std::remove((dir + "/osmdbt-sequence").c_str());
+    ::rmdir(dir.c_str());
+}
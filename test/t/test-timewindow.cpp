@@ -0,0 +1,39 @@
+#include <catch.hpp>
+
+#include "timewindow.hpp"
+
+TEST_CASE("split time range without interval")
+{
+    osmium::Timestamp const start{"2020-02-20T20:00:00Z"};
+    osmium::Timestamp const end{"2020-02-20T21:00:00Z"};
+
+    auto const windows = split_time_range(start, end, 0);
+    REQUIRE(windows.size() == 1);
+    REQUIRE(windows[0].start == start);
+    REQUIRE(windows[0].end == end);
+}
+
+TEST_CASE("split time range into windows")
+{
+    osmium::Timestamp const start{"2020-02-20T20:00:00Z"};
+    osmium::Timestamp const end{"2020-02-20T20:02:30Z"};
+
+    auto const windows = split_time_range(start, end, 60);
+    REQUIRE(windows.size() == 3);
+    REQUIRE(windows[0].start == start);
+    REQUIRE(windows[0].end == osmium::Timestamp{"2020-02-20T20:01:00Z"});
+    REQUIRE(windows[1].start == osmium::Timestamp{"2020-02-20T20:01:00Z"});
+    REQUIRE(windows[1].end == osmium::Timestamp{"2020-02-20T20:02:00Z"});
+    REQUIRE(windows[2].start == osmium::Timestamp{"2020-02-20T20:02:00Z"});
+    REQUIRE(windows[2].end == end);
+}
+
+TEST_CASE("split time range with open end")
+{
+    osmium::Timestamp const start{"2020-02-20T20:00:00Z"};
+
+    auto const windows = split_time_range(start, osmium::Timestamp{}, 86400);
+    REQUIRE(windows.size() > 1);
+    REQUIRE(windows.front().start == start);
+    REQUIRE_FALSE(windows.back().end.valid());
+}
@@ -0,0 +1,48 @@
+
+#include <catch.hpp>
+
+#include "timings.hpp"
+
+TEST_CASE("histogram bucket index is monotonic and continuous")
+{
+    std::size_t last = 0;
+    for (std::uint64_t v = 0; v < 100000; ++v) {
+        auto const index = LatencyHistogram::bucket_index(v);
+        REQUIRE(index >= last);
+        REQUIRE(index <= last + 1);
+        REQUIRE(LatencyHistogram::bucket_upper_bound(index) >= v);
+        last = index;
+    }
+}
+
+TEST_CASE("histogram bucket upper bound has small relative error")
+{
+    for (std::uint64_t v : {10ULL, 999ULL, 123456ULL, 98765432100ULL}) {
+        auto const upper =
+            LatencyHistogram::bucket_upper_bound(LatencyHistogram::bucket_index(v));
+        REQUIRE(upper >= v);
+        REQUIRE(upper - v <= v / 8);
+    }
+
+    REQUIRE(LatencyHistogram::bucket_index(~0ULL) < 64 * 8);
+}
+
+TEST_CASE("histogram quantiles")
+{
+    LatencyHistogram hist;
+    REQUIRE(hist.quantile(0.5) == 0);
+
+    for (std::uint64_t v = 1; v <= 1000; ++v) {
+        hist.record(v * 1000);
+    }
+
+    REQUIRE(hist.count() == 1000);
+    REQUIRE(hist.sum() == 500500000);
+    REQUIRE(hist.max() == 1000000);
+
+    auto const median = hist.quantile(0.5);
+    REQUIRE(median >= 500000);
+    REQUIRE(median <= 500000 + 500000 / 8);
+
+    REQUIRE(hist.quantile(1.0) == 1000000);
+}
@@ -40,3 +40,27 @@ TEST_CASE("create_replication_log_name")
     REQUIRE(create_replication_log_name("bar", 1345834023) ==
             "/osm-repl-2012-08-24T18:47:03Z-bar.log");
 }
+
+TEST_CASE("is_log_file_name")
+{
+    REQUIRE(is_log_file_name("osm-repl-2012-08-24T18:47:03Z-lsn-0-1.log"));
+    REQUIRE(is_log_file_name("osm-repl-x.log"));
+    REQUIRE_FALSE(is_log_file_name("osm-repl-.log"));
+    REQUIRE_FALSE(is_log_file_name("osm-repl-x.log.new"));
+    REQUIRE_FALSE(is_log_file_name("osm-repl-x.osc.gz"));
+    REQUIRE_FALSE(is_log_file_name("foo.log"));
+}
+
+TEST_CASE("lsn_from_log_file_name")
+{
+    REQUIRE(lsn_from_log_file_name(
+                "osm-repl-2012-08-24T18:47:03Z-lsn-0-1.log") == 1);
+    REQUIRE(lsn_from_log_file_name(
+                "osm-repl-2012-08-24T18:47:03Z-lsn-1A-16B3748.log") ==
+            0x1a016b3748ULL);
+    REQUIRE(lsn_from_log_file_name(
+                "osm-repl-2012-08-24T18:47:03Z-2012-08-24T18:00:00Z.log") ==
+            0);
+    REQUIRE(lsn_from_log_file_name("osm-repl-x-lsn-1.log") == 0);
+    REQUIRE(lsn_from_log_file_name("osm-repl-x-lsn-1-2.log.new") == 0);
+}